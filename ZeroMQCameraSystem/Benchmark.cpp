@@ -0,0 +1,1190 @@
+﻿#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <fstream>
+#include <numeric>
+#include <functional>
+#include <direct.h>
+#include <zmq.hpp>
+#include <opencv2/opencv.hpp>
+#include "scanner_darkly_effect.hpp"
+#include "effect_kernels.hpp"
+#include "incremental_effect.hpp"
+#include "effect_quality.hpp"
+#include "frame_messages.hpp"
+#include "palette_codec.hpp"
+#include "result_outbox.hpp"
+#include "video_processing.pb.h"
+
+// Бенчмарк ScannerDarklyEffect вне конвейера Capturer -> Worker -> Composer
+// Запуск: 4_Benchmark.exe [путь_к_изображению]  (без аргумента - синтетический кадр 640x480)
+// Набор замеров этапов: 4_Benchmark.exe --suite [--format json|csv] [--output файл] [--repeats N] [--sample P] [путь_к_изображению]
+// Эталонная регрессия: 4_Benchmark.exe --golden update|check [--golden-dir папка] [--min-psnr дБ] [--min-ssim S] [--min-iou I] [изображения...]
+
+// Счетчик выделений кучи через operator new (весь процесс, включая STL внутри OpenCV)
+std::atomic<uint64_t> g_heap_allocations(0);
+
+void* operator new(size_t size) {
+	g_heap_allocations++;
+	if (void* p = std::malloc(size ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+
+// Аллокатор cv::Mat со счетчиком: оборачивает стандартный, считает выделения данных матриц
+class CountingMatAllocator : public cv::MatAllocator {
+public:
+	explicit CountingMatAllocator(cv::MatAllocator* base) : base_(base) {}
+
+	cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+		cv::AccessFlag flags, cv::UMatUsageFlags usage) const override {
+		if (!data) {
+			allocations++;  // Матрица поверх чужих данных не выделяет память
+		}
+		return base_->allocate(dims, sizes, type, data, step, flags, usage);
+	}
+
+	bool allocate(cv::UMatData* data, cv::AccessFlag flags, cv::UMatUsageFlags usage) const override {
+		return base_->allocate(data, flags, usage);
+	}
+
+	void deallocate(cv::UMatData* data) const override {
+		base_->deallocate(data);  // Не вызывается: UMatData ссылается на базовый аллокатор
+	}
+
+	mutable std::atomic<uint64_t> allocations{ 0 };
+
+private:
+	cv::MatAllocator* base_;
+};
+
+// Синтетический кадр: градиент, фигуры и шум (повторяемый от запуска к запуску)
+cv::Mat make_synthetic_frame(cv::Size size) {
+	cv::Mat frame(size, CV_8UC3);
+	for (int y = 0; y < frame.rows; y++) {
+		cv::Vec3b* row = frame.ptr<cv::Vec3b>(y);
+		for (int x = 0; x < frame.cols; x++) {
+			row[x] = cv::Vec3b(
+				static_cast<uchar>(255 * x / frame.cols),  // Синий - горизонтальный градиент
+				static_cast<uchar>(255 * y / frame.rows),  // Зеленый - вертикальный градиент
+				static_cast<uchar>((x + y) % 256));        // Красный - диагональные полосы
+		}
+	}
+	cv::circle(frame, cv::Point(size.width / 3, size.height / 2), size.height / 4, cv::Scalar(40, 180, 220), cv::FILLED);
+	cv::rectangle(frame, cv::Rect(size.width / 2, size.height / 4, size.width / 3, size.height / 3), cv::Scalar(200, 60, 30), cv::FILLED);
+	cv::Mat noisy, noise(size, CV_16SC3);
+	cv::RNG rng(12345);  // Фиксированный seed
+	rng.fill(noise, cv::RNG::NORMAL, 0, 12);  // Гауссов шум со знаком
+	frame.convertTo(noisy, CV_16SC3);
+	noisy += noise;
+	noisy.convertTo(frame, CV_8UC3);  // Насыщение обратно в 0..255
+	return frame;
+}
+
+// Среднеквадратичная цветовая ошибка на пиксель (евклидово расстояние в BGR)
+double color_rmse(const cv::Mat& a, const cv::Mat& b) {
+	return cv::norm(a, b, cv::NORM_L2) / std::sqrt(static_cast<double>(a.total()));
+}
+
+// Среднее время выполнения функции в миллисекундах
+template <typename Func>
+double time_ms(Func&& func, int repeats) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < repeats; i++) {
+		func();
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count() / repeats;
+}
+
+// Отчет: k-means на подвыборке против полного k-means (время и цветовая ошибка)
+void report_kmeans_sampling(const cv::Mat& frame, int levels) {
+	const int repeats = 3;
+	ScannerDarklyEffect effect;
+	effect.setColorQuantizationLevels(levels);
+
+	cv::Mat full;
+	cv::theRNG().state = 0x12345678;  // Повторяемая инициализация KMEANS_PP_CENTERS
+	double full_ms = time_ms([&] { full = effect.colorQuantization(frame); }, repeats);
+
+	std::cout << "=== k-means sampling: " << frame.cols << "x" << frame.rows << ", levels " << levels << " ===" << std::endl;
+	std::cout << std::left << std::setw(10) << "mode" << std::setw(10) << "percent" << std::setw(12) << "time ms"
+		<< std::setw(10) << "speedup" << std::setw(14) << "rmse(orig)" << "rmse(full)" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << std::setw(10) << "full" << std::setw(10) << 100 << std::setw(12) << full_ms
+		<< std::setw(10) << 1.0 << std::setw(14) << color_rmse(frame, full) << 0.0 << std::endl;
+
+	for (bool random : { false, true }) {
+		for (int percent : { 1, 2, 5, 10, 25 }) {
+			effect.setKMeansSampling(percent, random);
+			cv::Mat sampled;
+			cv::theRNG().state = 0x12345678;
+			double ms = time_ms([&] { sampled = effect.colorQuantization(frame); }, repeats);
+			std::cout << std::setw(10) << (random ? "random" : "strided") << std::setw(10) << percent
+				<< std::setw(12) << ms << std::setw(10) << full_ms / ms
+				<< std::setw(14) << color_rmse(frame, sampled) << color_rmse(full, sampled) << std::endl;
+		}
+	}
+	effect.setKMeansSampling(100, false);
+}
+
+// Отчет: назначение через LUT 32x32x32 против точного поиска ближайшего центра (та же палитра)
+void report_palette_lut(const cv::Mat& frame, int levels, int percent) {
+	const int repeats = 3;
+	ScannerDarklyEffect effect;
+	effect.setColorQuantizationLevels(levels);
+	effect.setKMeansSampling(percent, false);
+
+	cv::Mat exact, lut;
+	cv::theRNG().state = 0x12345678;  // Одинаковая палитра в обоих прогонах
+	double exact_ms = time_ms([&] { cv::theRNG().state = 0x12345678; exact = effect.colorQuantization(frame); }, repeats);
+	effect.setPaletteLut(true);
+	double lut_ms = time_ms([&] { cv::theRNG().state = 0x12345678; lut = effect.colorQuantization(frame); }, repeats);
+
+	cv::Mat diff;
+	cv::absdiff(exact, lut, diff);
+	cv::Mat diff_gray = diff.reshape(1, static_cast<int>(diff.total()));  // Каналы в столбцы
+	cv::Mat mismatch;
+	cv::reduce(diff_gray, mismatch, 1, cv::REDUCE_MAX);  // Пиксель отличается, если отличается хотя бы один канал
+	double mismatch_percent = 100.0 * cv::countNonZero(mismatch) / static_cast<double>(frame.total());
+
+	std::cout << "=== Palette LUT: " << frame.cols << "x" << frame.rows << ", levels " << levels
+		<< ", sample " << percent << "% ===" << std::endl;
+	std::cout << std::fixed << std::setprecision(2)
+		<< "exact " << exact_ms << " ms, lut " << lut_ms << " ms (x" << exact_ms / lut_ms << "), "
+		<< "mismatched pixels " << mismatch_percent << "%, rmse(exact) " << color_rmse(exact, lut)
+		<< ", rmse(orig) exact " << color_rmse(frame, exact) << " / lut " << color_rmse(frame, lut) << std::endl;
+}
+
+// Скалярный float-цикл назначения (как в ScannerDarklyEffect без SIMD) - эталон для микробенчмарка
+void assign_float_loop(const cv::Mat& image, cv::Mat& quantized, const std::vector<cv::Vec3b>& palette) {
+	for (int y = 0; y < image.rows; y++) {
+		const cv::Vec3b* src = image.ptr<cv::Vec3b>(y);
+		cv::Vec3b* dst = quantized.ptr<cv::Vec3b>(y);
+		for (int x = 0; x < image.cols; x++) {
+			float best_dist = FLT_MAX;
+			size_t best_idx = 0;
+			for (size_t j = 0; j < palette.size(); j++) {
+				float db = static_cast<float>(src[x][0]) - palette[j][0];
+				float dg = static_cast<float>(src[x][1]) - palette[j][1];
+				float dr = static_cast<float>(src[x][2]) - palette[j][2];
+				float dist = db * db + dg * dg + dr * dr;
+				if (dist < best_dist) {
+					best_dist = dist;
+					best_idx = j;
+				}
+			}
+			dst[x] = palette[best_idx];
+		}
+	}
+}
+
+// Микробенчмарк: SIMD-ядро назначения против скалярного float-цикла (4, 8, 16 центров)
+void report_simd_assignment(const cv::Mat& frame) {
+	const int repeats = 10;
+	std::cout << "=== SIMD assignment: " << frame.cols << "x" << frame.rows << " ===" << std::endl;
+	for (int count : { 4, 8, 16 }) {
+		std::vector<cv::Vec3b> palette(count);
+		cv::RNG rng(count);
+		for (auto& color : palette) {
+			color = cv::Vec3b(static_cast<uchar>(rng.uniform(0, 256)), static_cast<uchar>(rng.uniform(0, 256)), static_cast<uchar>(rng.uniform(0, 256)));
+		}
+
+		cv::Mat scalar_out(frame.size(), CV_8UC3), simd_out(frame.size(), CV_8UC3);
+		double scalar_ms = time_ms([&] { assign_float_loop(frame, scalar_out, palette); }, repeats);
+		double simd_ms = time_ms([&] {
+			for (int y = 0; y < frame.rows; y++) {
+				effect_kernels::assignRowNearest(frame.ptr<uchar>(y), simd_out.ptr<uchar>(y), nullptr,
+					frame.cols, palette.data(), count);
+			}
+		}, repeats);
+
+		double pixels = static_cast<double>(frame.total());
+		std::cout << std::fixed << std::setprecision(2) << "centers " << std::setw(3) << count
+			<< ": scalar " << scalar_ms << " ms (" << scalar_ms * 1e6 / pixels << " ns/px), simd "
+			<< simd_ms << " ms (" << simd_ms * 1e6 / pixels << " ns/px), x" << scalar_ms / simd_ms
+			<< ", rmse " << color_rmse(scalar_out, simd_out) << std::endl;
+	}
+}
+
+// Микробенчмарк специализированных ядер назначения (уровни 4/6/8/16, черные и белые контуры) против общего ядра
+// на той же палитре и маске контуров; результат должен совпадать побитно
+void report_specialized_kernels(const cv::Mat& frame) {
+	const int repeats = 10;
+	std::cout << "=== Specialized kernels: " << frame.cols << "x" << frame.rows << " ===" << std::endl;
+	cv::Mat gray, edges;
+	cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+	cv::Canny(gray, edges, 60, 160);
+	for (int count : { 4, 6, 8, 16 }) {
+		std::vector<cv::Vec3b> palette(count);
+		cv::RNG rng(count);
+		for (auto& color : palette) {
+			color = cv::Vec3b(static_cast<uchar>(rng.uniform(0, 256)), static_cast<uchar>(rng.uniform(0, 256)), static_cast<uchar>(rng.uniform(0, 256)));
+		}
+		for (uchar contour : { static_cast<uchar>(0), static_cast<uchar>(255) }) {
+			const effect_kernels::AssignRowFn specialized = effect_kernels::selectAssignRow(count, contour);
+			cv::Mat generic_out(frame.size(), CV_8UC3), specialized_out(frame.size(), CV_8UC3);
+			auto run = [&](effect_kernels::AssignRowFn kernel, cv::Mat& out) {
+				for (int y = 0; y < frame.rows; y++) {
+					kernel(frame.ptr<uchar>(y), out.ptr<uchar>(y), nullptr, frame.cols, palette.data(), count,
+						edges.ptr<uchar>(y), contour);
+				}
+			};
+			double generic_ms = time_ms([&] { run(&effect_kernels::assignRowNearestT<0, -1>, generic_out); }, repeats);
+			double specialized_ms = time_ms([&] { run(specialized, specialized_out); }, repeats);
+
+			double pixels = static_cast<double>(frame.total());
+			std::cout << std::fixed << std::setprecision(2) << "levels " << std::setw(2) << count
+				<< (contour ? " white" : " black") << ": generic " << generic_ms << " ms ("
+				<< generic_ms * 1e6 / pixels << " ns/px), specialized " << specialized_ms << " ms ("
+				<< specialized_ms * 1e6 / pixels << " ns/px), x" << generic_ms / specialized_ms
+				<< (cv::norm(generic_out, specialized_out, cv::NORM_INF) == 0 ? ", identical" : ", DIFFERENT") << std::endl;
+		}
+	}
+}
+
+// Толстые контуры: cv::dilate по байтовой маске + setTo против битовой маски (упаковка, дилатация, наложение);
+// результат должен совпадать побитно, объем маски - в 8 раз меньше
+void report_bit_dilation(const cv::Mat& frame) {
+	const int repeats = 10;
+	std::cout << "=== Bit-packed dilation: " << frame.cols << "x" << frame.rows << " ===" << std::endl;
+	cv::Mat gray, edges;
+	cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+	cv::Canny(gray, edges, 60, 160);
+	cv::Mat base = frame.clone();  // Вместо квантованного кадра - любой BGR кадр
+	for (int kernel : { 3, 5, 7, 9 }) {
+		cv::Mat byte_out, bit_out, dilated;
+		const cv::Mat element = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(kernel, kernel));
+		double byte_ms = time_ms([&] {
+			cv::dilate(edges, dilated, element);
+			base.copyTo(byte_out);
+			byte_out.setTo(cv::Scalar(0, 0, 0), dilated);
+		}, repeats);
+
+		effect_kernels::BitMask bits, dilated_bits, scratch;
+		double bit_ms = time_ms([&] {
+			effect_kernels::packMask(edges, bits);
+			effect_kernels::dilateBits(bits, kernel, dilated_bits, scratch);
+			base.copyTo(bit_out);
+			for (int y = 0; y < bit_out.rows; y++) {
+				effect_kernels::overlayRowBits(dilated_bits.row(y), 0, bit_out.ptr<uchar>(y), bit_out.cols, 0);
+			}
+		}, repeats);
+
+		std::cout << std::fixed << std::setprecision(2) << "kernel " << kernel << ": bytes " << byte_ms
+			<< " ms, bits " << bit_ms << " ms, x" << byte_ms / bit_ms << ", mask " << edges.total() << " -> "
+			<< dilated_bits.bits.size() * sizeof(uint64_t) << " bytes"
+			<< (cv::norm(byte_out, bit_out, cv::NORM_INF) == 0 ? ", identical" : ", DIFFERENT") << std::endl;
+	}
+}
+
+// Масштабирование параллельного пути по числу потоков (полосы = потоки) и проверка совпадения контуров
+void report_parallel_scaling(const cv::Mat& frame) {
+	const int repeats = 5;
+	const int max_threads = cv::getNumberOfCPUs();
+	ScannerDarklyEffect effect;
+	effect.setKMeansSampling(5, false);  // Подвыборка, чтобы k-means не доминировал в замере
+
+	std::cout << "=== Parallel strips: " << frame.cols << "x" << frame.rows << ", sample 5% ===" << std::endl;
+	double base_ms = 0.0;
+	for (int threads = 1; threads <= max_threads; threads++) {
+		cv::setNumThreads(threads);
+		effect.setParallelStrips(0);
+		double serial_ms = time_ms([&] { effect.applyEffect(frame); }, repeats);
+		cv::Mat serial_edges = effect.extractEdges(frame);
+
+		effect.setParallelStrips(threads);
+		double parallel_ms = time_ms([&] { effect.applyEffect(frame); }, repeats);
+		cv::Mat strip_edges = effect.extractEdgesStrips(frame);
+		if (threads == 1) {
+			base_ms = parallel_ms;
+		}
+
+		std::cout << std::fixed << std::setprecision(2) << "threads " << std::setw(3) << threads
+			<< ": serial " << serial_ms << " ms, strips " << parallel_ms << " ms, scaling x" << base_ms / parallel_ms
+			<< ", edges " << (cv::norm(serial_edges, strip_edges, cv::NORM_INF) == 0 ? "identical" : "DIFFER") << std::endl;
+	}
+	cv::setNumThreads(-1);  // Вернуть число потоков по умолчанию
+}
+
+// Однопроходный вывод против colorQuantization + combineEffect (время и побитное совпадение)
+void report_fused_output(const cv::Mat& frame) {
+	const int repeats = 5;
+	ScannerDarklyEffect effect;
+	std::cout << "=== Fused output: " << frame.cols << "x" << frame.rows << " ===" << std::endl;
+	for (int percent : { 5, 100 }) {
+		for (bool black : { true, false }) {
+			effect.setKMeansSampling(percent, false);
+			effect.setBlackContours(black);
+			cv::Mat separate, fused;
+			effect.setFusedOutput(false);
+			double separate_ms = time_ms([&] { cv::theRNG().state = 0x12345678; separate = effect.applyEffect(frame); }, repeats);
+			effect.setFusedOutput(true);
+			double fused_ms = time_ms([&] { cv::theRNG().state = 0x12345678; fused = effect.applyEffect(frame); }, repeats);
+
+			std::cout << std::fixed << std::setprecision(2) << "sample " << std::setw(3) << percent << "%, "
+				<< (black ? "black" : "white") << ": separate " << separate_ms << " ms, fused " << fused_ms
+				<< " ms (x" << separate_ms / fused_ms << "), output "
+				<< (cv::norm(separate, fused, cv::NORM_INF) == 0 ? "identical" : "DIFFER") << std::endl;
+		}
+	}
+}
+
+// Целочисленный k-means против cv::kmeans на CV_32F: время и качество палитры.
+// Допуск: rmse(orig) целочисленного не больше rmse(orig) cv::kmeans * 1.05 + 0.5. false - допуск превышен
+bool report_integer_kmeans(const cv::Mat& frame, int levels) {
+	const int repeats = 3;
+	const double tolerance_ratio = 1.05;
+	const double tolerance_abs = 0.5;
+	bool passed = true;
+	std::cout << "=== Integer k-means: " << frame.cols << "x" << frame.rows << ", levels " << levels << " ===" << std::endl;
+	for (int percent : { 100, 5 }) {
+		ScannerDarklyEffect effect;
+		effect.setColorQuantizationLevels(levels);
+		effect.setKMeansSampling(percent, false);
+
+		cv::Mat float_result, int_result;
+		double float_ms = time_ms([&] { cv::theRNG().state = 0x12345678; float_result = effect.colorQuantization(frame); }, repeats);
+		effect.setIntegerKMeans(true);
+		double int_ms = time_ms([&] { cv::theRNG().state = 0x12345678; int_result = effect.colorQuantization(frame); }, repeats);
+
+		const double float_rmse = color_rmse(frame, float_result);
+		const double int_rmse = color_rmse(frame, int_result);
+		const bool ok = int_rmse <= float_rmse * tolerance_ratio + tolerance_abs;
+		passed = passed && ok;
+		std::cout << std::fixed << std::setprecision(2) << (ok ? "- [ OK ] " : "- [FAIL] ")
+			<< "sample " << std::setw(3) << percent << "%: float " << float_ms << " ms, int " << int_ms
+			<< " ms (x" << float_ms / int_ms << "), rmse(orig) float " << float_rmse << " / int " << int_rmse
+			<< ", rmse(float) " << color_rmse(float_result, int_result) << std::endl;
+	}
+	return passed;
+}
+
+// Median cut против k-means: время обучения и назначения, RMSE к исходному кадру и повторяемость палитры
+// при разном состоянии генератора (k-means++ зависит от него, median cut - нет)
+void report_median_cut(const cv::Mat& frame) {
+	const int repeats = 3;
+	std::cout << "=== Median cut palette: " << frame.cols << "x" << frame.rows << " ===" << std::endl;
+	for (int levels : { 8, 16 }) {
+		ScannerDarklyEffect effect;
+		effect.setColorQuantizationLevels(levels);
+		effect.setIntegerKMeans(true);  // Та же выборка и то же назначение - различие только в построении палитры
+
+		cv::Mat kmeans_result, median_result;
+		double kmeans_ms = time_ms([&] { cv::theRNG().state = 0x12345678; kmeans_result = effect.colorQuantization(frame); }, repeats);
+		const std::vector<cv::Vec3b> kmeans_palette = effect.palette();
+		cv::theRNG().state = 0x9E3779B9;  // Другое состояние генератора - как на другом Worker'е
+		effect.colorQuantization(frame);
+		const bool kmeans_repeatable = effect.palette() == kmeans_palette;
+
+		effect.setMedianCutPalette(true);
+		double median_ms = time_ms([&] { cv::theRNG().state = 0x12345678; median_result = effect.colorQuantization(frame); }, repeats);
+		const std::vector<cv::Vec3b> median_palette = effect.palette();
+		cv::theRNG().state = 0x9E3779B9;
+		effect.colorQuantization(frame);
+		const bool median_repeatable = effect.palette() == median_palette;
+
+		std::cout << std::fixed << std::setprecision(2) << "levels " << std::setw(2) << levels
+			<< ": k-means " << kmeans_ms << " ms, median cut " << median_ms << " ms (x" << kmeans_ms / median_ms
+			<< "), rmse(orig) k-means " << color_rmse(frame, kmeans_result) << " / median cut " << color_rmse(frame, median_result)
+			<< ", colors " << median_palette.size() << ", repeatable k-means " << (kmeans_repeatable ? "yes" : "no")
+			<< " / median cut " << (median_repeatable ? "yes" : "no") << std::endl;
+	}
+}
+
+// Инкрементальный режим на последовательности неподвижной камеры (движется только небольшой квадрат):
+// среднее время кадра, доля пересчитанных плиток и отличие от полного пересчета
+void report_incremental(const cv::Mat& frame) {
+	const int frames = 30;
+	const int square = std::max(16, frame.rows / 10);
+	ScannerDarklyEffect full_effect, tiled_effect;
+	full_effect.setKMeansSampling(5, false);
+	tiled_effect.setKMeansSampling(5, false);
+	IncrementalEffect incremental(tiled_effect);
+	incremental.setRefreshInterval(0);  // Без планового обновления - видна только доля измененных плиток
+
+	double full_ms = 0.0, incremental_ms = 0.0, recomputed_sum = 0.0, rmse_sum = 0.0;
+	cv::Mat full_output, incremental_output;
+	for (int i = 0; i < frames; i++) {
+		cv::Mat moving = frame.clone();
+		const int x = (i * 8) % std::max(1, frame.cols - square);
+		cv::rectangle(moving, cv::Rect(x, frame.rows / 2, square, square), cv::Scalar(30, 220, 250), cv::FILLED);
+
+		cv::theRNG().state = 0x12345678;
+		full_ms += time_ms([&] { full_effect.applyEffect(moving, full_output); }, 1);
+		double recomputed = 0.0;
+		cv::theRNG().state = 0x12345678;
+		incremental_ms += time_ms([&] { recomputed = incremental.apply("benchmark", moving, incremental_output); }, 1);
+		if (i > 0) {
+			recomputed_sum += recomputed;  // Первый кадр всегда полный
+			rmse_sum += color_rmse(full_output, incremental_output);
+		}
+	}
+	std::cout << "=== Incremental tiles: " << frame.cols << "x" << frame.rows << ", " << frames
+		<< " frames, moving square " << square << "px ===" << std::endl;
+	std::cout << std::fixed << std::setprecision(2) << "full " << full_ms / frames << " ms/frame, incremental "
+		<< incremental_ms / frames << " ms/frame (x" << full_ms / incremental_ms << "), tiles recomputed "
+		<< recomputed_sum * 100.0 / (frames - 1) << "%, rmse(full) " << rmse_sum / (frames - 1) << std::endl;
+}
+
+// Пакеты Worker'а (worker_batch_max): палитра на каждый кадр против общей палитры пакета на последовательности
+// с шумом сенсора и движущимся квадратом. Время кадра и мерцание - RMSE между соседними результатами
+// (у неподвижной камеры без мерцания меняется только квадрат)
+void report_batch_palette(const cv::Mat& frame) {
+	const int frames = 24;
+	const int square = std::max(16, frame.rows / 10);
+	std::vector<cv::Mat> sequence;
+	cv::RNG rng(0x2545F491);
+	for (int i = 0; i < frames; i++) {
+		cv::Mat noise_up(frame.size(), frame.type()), noise_down(frame.size(), frame.type()), noisy;
+		rng.fill(noise_up, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(4));
+		rng.fill(noise_down, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(4));
+		cv::add(frame, noise_up, noisy);
+		cv::subtract(noisy, noise_down, noisy);
+		const int x = (i * 8) % std::max(1, frame.cols - square);
+		cv::rectangle(noisy, cv::Rect(x, frame.rows / 2, square, square), cv::Scalar(30, 220, 250), cv::FILLED);
+		sequence.push_back(noisy);
+	}
+
+	std::cout << "=== Batch palette: " << frame.cols << "x" << frame.rows << ", " << frames
+		<< " noisy frames, moving square " << square << "px ===" << std::endl;
+	for (int batch_size : { 1, 2, 4, 8 }) {
+		ScannerDarklyEffect effect;
+		effect.setKMeansSampling(5, false);
+		cv::theRNG().state = 0x12345678;
+		std::vector<cv::Mat> outputs(frames);
+		std::vector<cv::Mat> batch;
+		const double total_ms = time_ms([&] {
+			for (int start = 0; start < frames; start += batch_size) {
+				if (batch_size == 1) {
+					effect.applyEffect(sequence[start], outputs[start]);  // Как без пакетов: обучение на каждом кадре
+					continue;
+				}
+				batch.assign(sequence.begin() + start, sequence.begin() + std::min(frames, start + batch_size));
+				effect.trainSharedPalette(batch);
+				for (size_t i = 0; i < batch.size(); i++) {
+					effect.applyEffectWithPalette(batch[i], outputs[start + i]);
+				}
+			}
+		}, 1);
+		double flicker = 0.0;
+		for (int i = 1; i < frames; i++) {
+			flicker += color_rmse(outputs[i - 1], outputs[i]);
+		}
+		std::cout << std::fixed << std::setprecision(2) << "batch " << batch_size
+			<< (batch_size == 1 ? " (palette per frame)" : "") << ": " << total_ms / frames
+			<< " ms/frame, flicker rmse " << flicker / (frames - 1) << std::endl;
+	}
+}
+
+// Быстрые уровни Worker'а: уменьшенное декодирование JPEG (IMREAD_REDUCED_COLOR_2/_4) и эффект в уменьшенном
+// масштабе с увеличением результата против полного уровня (время декодирования + эффекта, отличие результата)
+void report_reduced_tiers(const cv::Mat& frame) {
+	const int repeats = 5;
+	std::vector<uchar> jpeg;
+	cv::imencode(".jpg", frame, jpeg, { cv::IMWRITE_JPEG_QUALITY, 80 });  // Как кадр от Capturer
+
+	ScannerDarklyEffect effect;
+	effect.setKMeansSampling(5, false);
+	std::cout << "=== Reduced tiers: " << frame.cols << "x" << frame.rows << ", JPEG " << jpeg.size() / 1024 << " KB ===" << std::endl;
+	cv::Mat full_output;
+	double full_total = 0.0;
+	for (int scale : { 1, 2, 4 }) {
+		const int flags = scale == 1 ? cv::IMREAD_COLOR : (scale == 2 ? cv::IMREAD_REDUCED_COLOR_2 : cv::IMREAD_REDUCED_COLOR_4);
+		cv::Mat decoded, output;
+		double decode_ms = time_ms([&] { decoded = cv::imdecode(jpeg, flags); }, repeats);
+		double effect_ms = time_ms([&] {
+			cv::theRNG().state = 0x12345678;
+			effect.applyEffectUpscaled(decoded, scale, frame.size(), output);
+		}, repeats);
+		if (scale == 1) {
+			full_output = output.clone();
+			full_total = decode_ms + effect_ms;
+		}
+		std::cout << std::fixed << std::setprecision(2) << "tier 1/" << scale << " (" << decoded.cols << "x" << decoded.rows
+			<< "): decode " << decode_ms << " ms, effect " << effect_ms << " ms, total x" << full_total / (decode_ms + effect_ms)
+			<< ", rmse(full tier) " << color_rmse(full_output, output) << std::endl;
+	}
+}
+
+// Кодек обработанного кадра: JPEG (качество Worker'а) против PALETTE_RLE - размер, время кодирования
+// и декодирования, ошибка относительно результата эффекта (PALETTE_RLE - без потерь)
+void report_palette_codec(const cv::Mat& frame) {
+	const int repeats = 10;
+	std::cout << "=== Processed frame codec: " << frame.cols << "x" << frame.rows << " ===" << std::endl;
+	for (bool thick : { false, true }) {
+		ScannerDarklyEffect effect;
+		effect.setKMeansSampling(5, false);
+		effect.setDilationKernelSize(thick ? 5 : 0);
+		cv::Mat processed;
+		cv::theRNG().state = 0x12345678;
+		effect.applyEffect(frame, processed);
+
+		std::vector<uchar> jpeg;
+		cv::Mat jpeg_decoded;
+		const std::vector<int> params = { cv::IMWRITE_JPEG_QUALITY, 80 };
+		const double jpeg_encode_ms = time_ms([&] { cv::imencode(".jpg", processed, jpeg, params); }, repeats);
+		const double jpeg_decode_ms = time_ms([&] { jpeg_decoded = cv::imdecode(jpeg, cv::IMREAD_COLOR); }, repeats);
+
+		std::string rle;
+		cv::Mat rle_decoded;
+		bool encoded = true;
+		const double rle_encode_ms = time_ms([&] { encoded = palette_codec::encode(processed, rle); }, repeats);
+		if (!encoded) {
+			std::cout << "- [ -- ] more than " << palette_codec::max_colors << " colors, PALETTE_RLE falls back to JPEG" << std::endl;
+			continue;
+		}
+		const double rle_decode_ms = time_ms([&] { palette_codec::decode(rle, processed.cols, processed.rows, 3, rle_decoded); }, repeats);
+
+		std::cout << std::fixed << std::setprecision(2) << (thick ? "thick contours" : "default") << ", "
+			<< static_cast<int>(static_cast<uchar>(rle[0])) << " colors:" << std::endl;
+		std::cout << "JPEG q80   : " << std::setw(7) << jpeg.size() / 1024.0 << " KB, encode " << jpeg_encode_ms
+			<< " ms, decode " << jpeg_decode_ms << " ms, rmse " << color_rmse(processed, jpeg_decoded) << std::endl;
+		std::cout << "PALETTE_RLE: " << std::setw(7) << rle.size() / 1024.0 << " KB, encode " << rle_encode_ms
+			<< " ms, decode " << rle_decode_ms << " ms, rmse " << color_rmse(processed, rle_decoded) << std::endl;
+	}
+}
+
+// Форматы пикселей x кодирования сообщений (frame_messages): размер, время кодирования и декодирования,
+// ошибка круга кодирование -> декодирование. Кадр - результат эффекта (для PALETTE_RLE нужно не больше 255 цветов).
+// Без потерь (RAW, PNG, BMP, PALETTE_RLE) ошибка должна быть 0, иначе false. Затем - эффект по серому кадру против BGR
+bool report_pixel_formats(const cv::Mat& frame) {
+	const int repeats = 10;
+	const std::vector<int> params = { cv::IMWRITE_JPEG_QUALITY, 80 };
+	std::cout << "=== Pixel formats x encodings: " << frame.cols << "x" << frame.rows << " ===" << std::endl;
+	cv::Mat gray_frame;
+	cv::cvtColor(frame, gray_frame, cv::COLOR_BGR2GRAY);
+	ScannerDarklyEffect effect;
+	effect.setKMeansSampling(5, false);
+	cv::Mat color_processed, gray_processed;
+	cv::theRNG().state = 0x12345678;
+	const double color_ms = time_ms([&] { effect.applyEffect(frame, color_processed); }, repeats);
+	const double gray_ms = time_ms([&] { effect.applyEffect(gray_frame, gray_processed); }, repeats);
+
+	struct Format {
+		const char* name;
+		video_processing::PixelFormat format;
+	};
+	struct Encoding {
+		const char* name;
+		video_processing::ImageEncoding encoding;
+		bool lossless;
+	};
+	bool passed = true;
+	frame_messages::EncodeBuffers buffers;
+	video_processing::ImageData image_data;
+	cv::Mat decoded;
+	for (const Format& format : { Format{ "BGR ", video_processing::BGR }, Format{ "RGB ", video_processing::RGB },
+		Format{ "GRAY", video_processing::GRAY } }) {
+		const cv::Mat& image = format.format == video_processing::GRAY ? gray_processed : color_processed;  // Кадр компонента
+		for (const Encoding& encoding : { Encoding{ "RAW        ", video_processing::RAW, true },
+			Encoding{ "JPEG q80   ", video_processing::JPEG, false }, Encoding{ "PNG        ", video_processing::PNG, true },
+			Encoding{ "BMP        ", video_processing::BMP, true }, Encoding{ "PALETTE_RLE", video_processing::PALETTE_RLE, true } }) {
+			const double encode_ms = time_ms([&] {
+				frame_messages::encodeImageData(image, params, format.format, encoding.encoding, buffers, &image_data);
+			}, repeats);
+			bool ok = true;
+			const double decode_ms = time_ms([&] { ok = frame_messages::decodeImageData(image_data, 1, false, decoded); }, repeats);
+			const double rmse = ok && decoded.type() == image.type() ? color_rmse(image, decoded) : -1.0;
+			const bool lossless = encoding.lossless && image_data.encoding() == encoding.encoding;  // PALETTE_RLE мог замениться на JPEG
+			const bool failed = rmse < 0.0 || (lossless && rmse != 0.0);
+			passed = passed && !failed;
+			std::cout << std::fixed << std::setprecision(2) << (failed ? "- [FAIL] " : "- [ OK ] ") << format.name << " "
+				<< encoding.name << ": " << std::setw(8) << image_data.image_data().size() / 1024.0 << " KB, encode "
+				<< encode_ms << " ms, decode " << decode_ms << " ms, rmse " << rmse
+				<< (image_data.encoding() != encoding.encoding ? " (fell back to JPEG)" : "") << std::endl;
+		}
+	}
+	std::cout << std::fixed << std::setprecision(2) << "effect: BGR " << color_ms << " ms, GRAY " << gray_ms
+		<< " ms (x" << color_ms / gray_ms << "), message bytes x1/3 for RAW" << std::endl;
+	return passed;
+}
+
+// Установившийся режим: после прогрева applyEffect(input, output) не пересоздает буферы эффекта и выходной кадр.
+// Выделения внутри OpenCV (kmeans, Canny, GaussianBlur) выводятся для сведения. false - проверка не пройдена
+bool report_steady_state_allocations(const cv::Mat& frame) {
+	const int warmup = 3;
+	const int frames = 10;
+	CountingMatAllocator mat_allocator(cv::Mat::getStdAllocator());
+	cv::Mat::setDefaultAllocator(&mat_allocator);
+
+	bool passed = true;
+	std::cout << "=== Steady-state allocations: " << frame.cols << "x" << frame.rows << ", per frame after "
+		<< warmup << " warmup frames ===" << std::endl;
+	for (int percent : { 5, 100 }) {
+		for (int strips : { 0, 4 }) {
+			ScannerDarklyEffect effect;
+			effect.setKMeansSampling(percent, false);
+			effect.setParallelStrips(strips);
+			cv::Mat output;
+			for (int i = 0; i < warmup; i++) {
+				effect.applyEffect(frame, output);
+			}
+
+			const uchar* output_data = output.data;
+			const uint64_t reallocations = effect.scratchReallocations();
+			const uint64_t heap_before = g_heap_allocations;
+			const uint64_t mats_before = mat_allocator.allocations;
+			for (int i = 0; i < frames; i++) {
+				effect.applyEffect(frame, output);
+			}
+			const uint64_t effect_reallocations = effect.scratchReallocations() - reallocations;
+			const bool ok = effect_reallocations == 0 && output.data == output_data;
+			passed = passed && ok;
+
+			std::cout << std::fixed << std::setprecision(1) << (ok ? "- [ OK ] " : "- [FAIL] ")
+				<< "sample " << std::setw(3) << percent << "%, strips " << strips
+				<< ": effect buffers reallocated " << effect_reallocations
+				<< ", output " << (output.data == output_data ? "reused" : "REALLOCATED")
+				<< ", opencv internal: mats " << (mat_allocator.allocations - mats_before) / static_cast<double>(frames)
+				<< ", operator new " << (g_heap_allocations - heap_before) / static_cast<double>(frames) << std::endl;
+		}
+	}
+	cv::Mat::setDefaultAllocator(nullptr);  // Вернуть стандартный аллокатор
+	return passed;
+}
+
+// Выделения на кадр в пути сообщений Worker -> Composer: кодирование оригинала и результата, сериализация
+// в буфер сообщения ZeroMQ (malloc, как в libzmq), разбор и декодирование. Прежний путь: новые сообщения на кадр,
+// ImageData по значению с копированием в пару, строка SerializeAsString, копия байтов перед imdecode.
+// Новый путь: переиспользуемые сообщения, кодирование на месте, сериализация сразу в буфер
+void report_message_allocations(const cv::Mat& frame) {
+	const int warmup = 3;
+	const int frames = 20;
+	const std::vector<int> params = { cv::IMWRITE_JPEG_QUALITY, 80 };
+	std::cout << "=== Message allocations: " << frame.cols << "x" << frame.rows << ", per frame after "
+		<< warmup << " warmup frames ===" << std::endl;
+
+	auto send = [](const void* data, size_t size) {  // Буфер zmq::message_t
+		void* message = std::malloc(size);
+		memcpy(message, data, size);
+		std::free(message);
+	};
+
+	cv::Mat decoded;
+	auto copy_path = [&] {
+		auto create_image_data = [&](const cv::Mat& image) {
+			video_processing::ImageData image_data;
+			std::vector<uchar> buffer;
+			cv::imencode(".jpg", image, buffer, params);
+			image_data.set_width(image.cols);
+			image_data.set_height(image.rows);
+			image_data.set_image_data(buffer.data(), buffer.size());
+			return image_data;
+		};
+		video_processing::VideoFrame output_frame;
+		output_frame.set_sender_id("worker_benchmark");
+		*output_frame.mutable_image_pair()->mutable_original() = create_image_data(frame);
+		*output_frame.mutable_image_pair()->mutable_processed() = create_image_data(frame);
+		std::string serialized = output_frame.SerializeAsString();
+		send(serialized.data(), serialized.size());
+
+		video_processing::VideoFrame received;
+		received.ParseFromString(serialized);
+		const std::string& data = received.image_pair().processed().image_data();
+		std::vector<uchar> bytes(data.begin(), data.end());
+		decoded = cv::imdecode(bytes, cv::IMREAD_COLOR);
+	};
+
+	video_processing::VideoFrame output_frame, received;
+	frame_messages::EncodeBuffers encode_buffers;
+	auto reuse_path = [&] {
+		output_frame.set_sender_id("worker_benchmark");
+		auto* image_pair = output_frame.mutable_image_pair();
+		frame_messages::encodeImageData(frame, params, video_processing::BGR, video_processing::JPEG,
+			encode_buffers, image_pair->mutable_original());
+		frame_messages::encodeImageData(frame, params, video_processing::BGR, video_processing::JPEG,
+			encode_buffers, image_pair->mutable_processed());
+		void* buffer = std::malloc(output_frame.ByteSizeLong());
+		output_frame.SerializeToArray(buffer, static_cast<int>(output_frame.ByteSizeLong()));
+		received.ParseFromArray(buffer, static_cast<int>(output_frame.ByteSizeLong()));
+		std::free(buffer);
+		decoded = cv::imdecode(frame_messages::encodedBytes(received.image_pair().processed().image_data()), cv::IMREAD_COLOR);
+	};
+
+	struct Path {
+		const char* name;
+		std::function<void()> run;
+	};
+	for (const Path& path : { Path{ "copy ", copy_path }, Path{ "reuse", reuse_path } }) {
+		for (int i = 0; i < warmup; i++) {
+			path.run();
+		}
+		const uint64_t heap_before = g_heap_allocations;
+		const double ms = time_ms(path.run, frames);
+		std::cout << std::fixed << std::setprecision(1) << path.name << ": operator new "
+			<< (g_heap_allocations - heap_before) / static_cast<double>(frames) << " per frame, "
+			<< std::setprecision(2) << ms << " ms per frame" << std::endl;
+	}
+}
+
+// Outbox Worker'а при заполненной очереди PUSH (worker_outbox_size=1): результат ждет в outbox с взведенным
+// POLLOUT и уходит, как только получатель снова читает. Без POLLOUT Worker ждал бы освобождения outbox вечно
+bool report_outbox_drain() {
+	const int message_size = 64;
+	std::cout << "=== Outbox drain: PUSH/PULL inproc, HWM 1, outbox 1 ===" << std::endl;
+	zmq::context_t context(1);
+	zmq::socket_t pull_socket(context, ZMQ_PULL);
+	zmq::socket_t push_socket(context, ZMQ_PUSH);
+	int hwm = 1;
+	int no_linger = 0;
+	pull_socket.setsockopt(ZMQ_RCVHWM, &hwm, sizeof(hwm));
+	push_socket.setsockopt(ZMQ_SNDHWM, &hwm, sizeof(hwm));
+	push_socket.setsockopt(ZMQ_LINGER, &no_linger, sizeof(no_linger));
+	pull_socket.bind("inproc://outbox_drain");
+	push_socket.connect("inproc://outbox_drain");
+
+	// Заполняем очередь PUSH, как Composer, который перестал читать
+	size_t filled = 0;
+	while (filled < 1000) {
+		zmq::message_t message(message_size);
+		memset(message.data(), 0, message_size);
+		if (!push_socket.send(message, ZMQ_DONTWAIT)) {
+			break;
+		}
+		filled++;
+	}
+
+	ResultOutbox outbox(1);
+	zmq::message_t result(message_size), extra(message_size);
+	memset(result.data(), 1, message_size);  // Метка результата из outbox
+	memset(extra.data(), 2, message_size);
+	const bool queued = outbox.send(push_socket, result) == ResultOutbox::SendResult::Queued;
+	const bool armed = outbox.pollEvents() == ZMQ_POLLOUT;  // Иначе основной цикл Worker'а не узнает о свободном месте
+	const bool dropped = outbox.send(push_socket, extra) == ResultOutbox::SendResult::Dropped;  // Outbox полон
+
+	// Получатель снова читает: по POLLOUT outbox отправляет результат
+	size_t received = 0;
+	bool result_received = false;
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (!result_received && std::chrono::steady_clock::now() < deadline) {
+		zmq::pollitem_t items[] = {
+			{ static_cast<void*>(pull_socket), 0, ZMQ_POLLIN, 0 },
+			{ static_cast<void*>(push_socket), 0, outbox.pollEvents(), 0 }
+		};
+		zmq::poll(items, 2, 10);
+		if (items[1].revents & ZMQ_POLLOUT) {
+			outbox.flush(push_socket);
+		}
+		zmq::message_t message;
+		while (pull_socket.recv(&message, ZMQ_DONTWAIT)) {
+			received++;
+			result_received = static_cast<const uchar*>(message.data())[0] == 1;
+		}
+	}
+
+	const bool ok = filled > 0 && queued && armed && dropped && outbox.empty() && result_received
+		&& received == filled + 1;  // Порядок сохранен: результат - после заполнивших очередь
+	std::cout << (ok ? "- [ OK ] " : "- [FAIL] ") << "filled " << filled << ", queued " << (queued ? "yes" : "no")
+		<< ", POLLOUT " << (armed ? "armed" : "not armed") << ", overflow " << (dropped ? "dropped" : "not dropped")
+		<< ", received " << received << ", outbox " << (outbox.empty() ? "drained" : "stuck") << std::endl;
+	return ok;
+}
+
+// ============================================================================
+//  Набор замеров этапов (--suite): разрешения, уровни квантования, ядра размытия
+// ============================================================================
+
+// Результат замера одного этапа в одной конфигурации
+struct StageResult {
+	std::string source;  // synthetic или имя файла
+	std::string stage;  // colorQuantization, colorQuantizationMedianCut, extractEdges, combineEffect, applyEffect
+	int width;
+	int height;
+	int levels;  // Уровни квантования (0 - не влияет на этап)
+	int kernel;  // Размер ядра Гаусса (0 - не влияет на этап)
+	int repeats;
+	double mean_ms;
+	double variance_ms2;  // Дисперсия времени итерации (мс^2)
+	double min_ms;
+	double ns_per_pixel;
+	double fps;
+	double rmse;  // Цветовая ошибка квантования к исходному кадру (-1 - не измеряется для этапа)
+};
+
+// Времена отдельных итераций в миллисекундах (после одной прогревочной)
+template <typename Func>
+std::vector<double> time_samples_ms(Func&& func, int repeats) {
+	func();  // Прогрев: буферы эффекта, кэши
+	std::vector<double> samples;
+	for (int i = 0; i < repeats; i++) {
+		auto start = std::chrono::steady_clock::now();
+		func();
+		auto end = std::chrono::steady_clock::now();
+		samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	return samples;
+}
+
+// Статистика по временам итераций
+StageResult make_result(const std::string& source, const std::string& stage, cv::Size size,
+	int levels, int kernel, const std::vector<double>& samples) {
+	StageResult r;
+	r.source = source;
+	r.stage = stage;
+	r.width = size.width;
+	r.height = size.height;
+	r.levels = levels;
+	r.kernel = kernel;
+	r.repeats = static_cast<int>(samples.size());
+	r.mean_ms = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+	r.variance_ms2 = 0.0;
+	for (double s : samples) {
+		r.variance_ms2 += (s - r.mean_ms) * (s - r.mean_ms);
+	}
+	r.variance_ms2 /= samples.size();
+	r.min_ms = *std::min_element(samples.begin(), samples.end());
+	r.ns_per_pixel = r.mean_ms * 1e6 / size.area();
+	r.fps = 1000.0 / r.mean_ms;
+	r.rmse = -1.0;
+	return r;
+}
+
+// Замеры этапов для одного кадра: quantization (k-means и median cut) по уровням, edges по ядрам, combine один раз,
+// applyEffect - все сочетания
+void run_stage_suite(const std::string& source, const cv::Mat& frame, int repeats, int sample_percent,
+	std::vector<StageResult>& results) {
+	const int levels_list[] = { 4, 8, 16 };
+	const int kernel_list[] = { 3, 5, 7 };
+	ScannerDarklyEffect effect;
+	effect.setKMeansSampling(sample_percent, false);
+
+	cv::Mat quantized, edges, combined, output;
+	for (int levels : levels_list) {
+		effect.setColorQuantizationLevels(levels);
+		effect.setMedianCutPalette(true);
+		results.push_back(make_result(source, "colorQuantizationMedianCut", frame.size(), levels, 0,
+			time_samples_ms([&] { quantized = effect.colorQuantization(frame); }, repeats)));
+		results.back().rmse = color_rmse(frame, quantized);
+		effect.setMedianCutPalette(false);
+		results.push_back(make_result(source, "colorQuantization", frame.size(), levels, 0,
+			time_samples_ms([&] { quantized = effect.colorQuantization(frame); }, repeats)));
+		results.back().rmse = color_rmse(frame, quantized);
+	}
+	for (int kernel : kernel_list) {
+		effect.setGaussianKernelSize(kernel);
+		results.push_back(make_result(source, "extractEdges", frame.size(), 0, kernel,
+			time_samples_ms([&] { edges = effect.extractEdges(frame); }, repeats)));
+	}
+	results.push_back(make_result(source, "combineEffect", frame.size(), 0, 0,
+		time_samples_ms([&] { combined = effect.combineEffect(quantized, edges); }, repeats)));
+	for (int levels : levels_list) {
+		for (int kernel : kernel_list) {
+			effect.setColorQuantizationLevels(levels);
+			effect.setGaussianKernelSize(kernel);
+			results.push_back(make_result(source, "applyEffect", frame.size(), levels, kernel,
+				time_samples_ms([&] { effect.applyEffect(frame, output); }, repeats)));
+		}
+	}
+}
+
+// Экранирование строки для JSON (имена файлов с обратными слешами Windows)
+std::string json_escape(const std::string& s) {
+	std::string out;
+	for (char c : s) {
+		if (c == '\\' || c == '"') {
+			out += '\\';
+		}
+		out += c;
+	}
+	return out;
+}
+
+void write_results_json(std::ostream& out, const std::vector<StageResult>& results) {
+	out << std::fixed << std::setprecision(4) << "[" << std::endl;
+	for (size_t i = 0; i < results.size(); i++) {
+		const StageResult& r = results[i];
+		out << "  {\"source\": \"" << json_escape(r.source) << "\", \"stage\": \"" << r.stage << "\", "
+			<< "\"width\": " << r.width << ", \"height\": " << r.height << ", "
+			<< "\"levels\": " << r.levels << ", \"kernel\": " << r.kernel << ", \"repeats\": " << r.repeats << ", "
+			<< "\"mean_ms\": " << r.mean_ms << ", \"variance_ms2\": " << r.variance_ms2 << ", \"min_ms\": " << r.min_ms << ", "
+			<< "\"ns_per_pixel\": " << r.ns_per_pixel << ", \"fps\": " << r.fps << ", \"rmse\": ";
+		if (r.rmse < 0) out << "null";
+		else out << r.rmse;
+		out << "}"
+			<< (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+	out << "]" << std::endl;
+}
+
+void write_results_csv(std::ostream& out, const std::vector<StageResult>& results) {
+	out << "source,stage,width,height,levels,kernel,repeats,mean_ms,variance_ms2,min_ms,ns_per_pixel,fps,rmse" << std::endl;
+	out << std::fixed << std::setprecision(4);
+	for (const StageResult& r : results) {
+		out << r.source << "," << r.stage << "," << r.width << "," << r.height << "," << r.levels << "," << r.kernel << ","
+			<< r.repeats << "," << r.mean_ms << "," << r.variance_ms2 << "," << r.min_ms << ","
+			<< r.ns_per_pixel << "," << r.fps << ",";
+		if (r.rmse >= 0) out << r.rmse;  // Пусто - не измеряется
+		out << std::endl;
+	}
+}
+
+// Режим --suite: синтетические кадры и (если задан) кадр из файла в 480p / 720p / 1080p / 4K
+int run_suite(int argc, char** argv) {
+	std::string format = "json";
+	std::string output_path;
+	std::string image_path;
+	int repeats = 5;
+	int sample_percent = 100;  // Как в Worker по умолчанию
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		if (arg == "--suite") {
+			continue;
+		}
+		if ((arg == "--format" || arg == "--output" || arg == "--repeats" || arg == "--sample") && i + 1 < argc) {
+			const std::string value = argv[++i];
+			if (arg == "--format") format = value;
+			else if (arg == "--output") output_path = value;
+			else if (arg == "--repeats") repeats = std::max(1, std::stoi(value));
+			else sample_percent = std::stoi(value);
+		}
+		else {
+			image_path = arg;
+		}
+	}
+	if (format != "json" && format != "csv") {
+		std::cout << "- [FAIL] Unknown format: " << format << " (json or csv)" << std::endl;
+		return -1;
+	}
+
+	cv::Mat file_frame;
+	if (!image_path.empty()) {
+		file_frame = cv::imread(image_path, cv::IMREAD_COLOR);
+		if (file_frame.empty()) {
+			std::cout << "- [FAIL] Cannot read image: " << image_path << std::endl;
+			return -1;
+		}
+	}
+
+	const cv::Size resolutions[] = { cv::Size(640, 480), cv::Size(1280, 720), cv::Size(1920, 1080), cv::Size(3840, 2160) };
+	std::vector<StageResult> results;
+	for (const cv::Size& size : resolutions) {
+		std::cout << "- [ -- ] Suite " << size.width << "x" << size.height << "..." << std::endl;
+		run_stage_suite("synthetic", make_synthetic_frame(size), repeats, sample_percent, results);
+		if (!file_frame.empty()) {
+			cv::Mat resized;
+			cv::resize(file_frame, resized, size, 0, 0, cv::INTER_AREA);  // Кадр из файла в нужном разрешении
+			run_stage_suite(image_path, resized, repeats, sample_percent, results);
+		}
+	}
+
+	if (output_path.empty()) {
+		if (format == "json") write_results_json(std::cout, results);
+		else write_results_csv(std::cout, results);
+		return 0;
+	}
+	std::ofstream out(output_path);
+	if (!out.is_open()) {
+		std::cout << "- [FAIL] Cannot write: " << output_path << std::endl;
+		return -1;
+	}
+	if (format == "json") write_results_json(out, results);
+	else write_results_csv(out, results);
+	std::cout << "- [ OK ] Suite results (" << results.size() << " rows) written to: " << output_path << std::endl;
+	return 0;
+}
+
+// ============================================================================
+//  Эталонная регрессия (--golden): результаты конфигураций против сохраненных эталонов
+// ============================================================================
+
+// Кадр фиксированного набора
+struct GoldenFrame {
+	std::string name;  // Имя файлов эталона
+	cv::Mat image;
+};
+
+// Конфигурация эффекта для сравнения с эталоном
+struct GoldenConfig {
+	std::string name;
+	std::function<void(ScannerDarklyEffect&)> setup;  // Настройки поверх значений по умолчанию
+	int scale;  // > 1 - быстрый уровень (кадр уменьшается как IMREAD_REDUCED_COLOR_*)
+	bool gated;  // Пороги применяются (false - строка только для сведения)
+};
+
+// Фиксированный набор: синтетические 640x480 и 1280x720 плюс изображения из командной строки
+std::vector<GoldenFrame> golden_frames(const std::vector<std::string>& image_paths) {
+	std::vector<GoldenFrame> frames;
+	frames.push_back({ "synthetic_640x480", make_synthetic_frame(cv::Size(640, 480)) });
+	frames.push_back({ "synthetic_1280x720", make_synthetic_frame(cv::Size(1280, 720)) });
+	for (const std::string& path : image_paths) {
+		cv::Mat image = cv::imread(path, cv::IMREAD_COLOR);
+		if (image.empty()) {
+			throw std::runtime_error("Cannot read image: " + path);
+		}
+		const size_t slash = path.find_last_of("/\\");
+		std::string name = path.substr(slash == std::string::npos ? 0 : slash + 1);
+		name = name.substr(0, name.find_last_of('.'));  // Имя файла без расширения
+		frames.push_back({ name, image });
+	}
+	return frames;
+}
+
+// Результат конфигурации для кадра (повторяемая инициализация k-means)
+cv::Mat golden_run(const GoldenConfig& config, const cv::Mat& frame) {
+	ScannerDarklyEffect effect;
+	config.setup(effect);
+	cv::Mat output;
+	cv::theRNG().state = 0x12345678;
+	if (config.scale > 1) {
+		cv::Mat reduced;
+		cv::resize(frame, reduced, cv::Size((frame.cols + config.scale - 1) / config.scale,
+			(frame.rows + config.scale - 1) / config.scale), 0, 0, cv::INTER_AREA);
+		effect.applyEffectUpscaled(reduced, config.scale, frame.size(), output);
+	}
+	else {
+		effect.applyEffect(frame, output);
+	}
+	return output;
+}
+
+// update - записать эталоны (эффект по умолчанию: полный k-means, без LUT, последовательно);
+// check - сравнить все конфигурации с эталонами, вывести таблицу скорость/качество, -1 при нарушении порогов
+int run_golden(int argc, char** argv) {
+	std::string mode = argc > 2 ? argv[2] : "";
+	std::string golden_dir = "golden";
+	double min_psnr = 30.0, min_ssim = 0.90, min_iou = 0.80;
+	std::vector<std::string> image_paths;
+	for (int i = 3; i < argc; i++) {
+		const std::string arg = argv[i];
+		if ((arg == "--golden-dir" || arg == "--min-psnr" || arg == "--min-ssim" || arg == "--min-iou") && i + 1 < argc) {
+			const std::string value = argv[++i];
+			if (arg == "--golden-dir") golden_dir = value;
+			else if (arg == "--min-psnr") min_psnr = std::stod(value);
+			else if (arg == "--min-ssim") min_ssim = std::stod(value);
+			else min_iou = std::stod(value);
+		}
+		else {
+			image_paths.push_back(arg);
+		}
+	}
+	if (mode != "update" && mode != "check") {
+		std::cout << "- [FAIL] Usage: --golden update|check [--golden-dir dir] [--min-psnr dB] [--min-ssim S] [--min-iou I] [images...]" << std::endl;
+		return -1;
+	}
+
+	const std::vector<GoldenFrame> frames = golden_frames(image_paths);
+	const GoldenConfig reference = { "reference", [](ScannerDarklyEffect&) {}, 1, true };
+	if (mode == "update") {
+		_mkdir(golden_dir.c_str());  // Папка может уже существовать
+		for (const GoldenFrame& frame : frames) {
+			const std::string path = golden_dir + "/" + frame.name + ".png";  // PNG - без потерь
+			if (!cv::imwrite(path, golden_run(reference, frame.image))) {
+				std::cout << "- [FAIL] Cannot write reference: " << path << std::endl;
+				return -1;
+			}
+			std::cout << "- [ OK ] Reference written: " << path << std::endl;
+		}
+		return 0;
+	}
+
+	const std::vector<GoldenConfig> configs = {
+		reference,
+		{ "sample 5%", [](ScannerDarklyEffect& e) { e.setKMeansSampling(5, false); }, 1, true },
+		{ "sample 5% + lut", [](ScannerDarklyEffect& e) { e.setKMeansSampling(5, false); e.setPaletteLut(true); }, 1, true },
+		{ "integer k-means", [](ScannerDarklyEffect& e) { e.setIntegerKMeans(true); }, 1, true },
+		{ "integer 5%", [](ScannerDarklyEffect& e) { e.setIntegerKMeans(true); e.setKMeansSampling(5, false); }, 1, true },
+		{ "float loop 5%", [](ScannerDarklyEffect& e) { e.setSimdAssignment(false); e.setKMeansSampling(5, false); }, 1, true },
+		{ "strips 4, 5%", [](ScannerDarklyEffect& e) { e.setParallelStrips(4); e.setKMeansSampling(5, false); }, 1, true },
+		{ "tier 1/2, 5%", [](ScannerDarklyEffect& e) { e.setKMeansSampling(5, false); }, 2, false },
+		{ "tier 1/4, 5%", [](ScannerDarklyEffect& e) { e.setKMeansSampling(5, false); }, 4, false },
+	};
+
+	bool passed = true;
+	std::cout << "=== Golden check: " << golden_dir << ", thresholds psnr >= " << min_psnr << " dB, ssim >= "
+		<< min_ssim << ", edge iou >= " << min_iou << " ===" << std::endl;
+	std::cout << std::left << std::setw(18) << "config" << std::setw(22) << "frame" << std::setw(10) << "ms"
+		<< std::setw(8) << "speedup" << std::setw(9) << "psnr" << std::setw(8) << "ssim" << std::setw(8) << "iou" << "status" << std::endl;
+	for (const GoldenFrame& frame : frames) {
+		const std::string path = golden_dir + "/" + frame.name + ".png";
+		const cv::Mat golden = cv::imread(path, cv::IMREAD_COLOR);
+		if (golden.empty() || golden.size() != frame.image.size()) {
+			std::cout << "- [FAIL] Missing or mismatched reference: " << path << " (run --golden update)" << std::endl;
+			passed = false;
+			continue;
+		}
+		const cv::Mat golden_edges = effect_quality::contourMask(golden, 0);  // Эталон - с черными контурами
+		double reference_ms = 0.0;
+		for (const GoldenConfig& config : configs) {
+			cv::Mat output;
+			const double ms = time_ms([&] { output = golden_run(config, frame.image); }, 3);
+			if (config.name == reference.name) {
+				reference_ms = ms;
+			}
+			const double psnr = effect_quality::psnr(output, golden);
+			const double ssim = effect_quality::ssim(output, golden);
+			const double iou = effect_quality::edgeIoU(effect_quality::contourMask(output, 0), golden_edges);
+			const bool ok = psnr >= min_psnr && ssim >= min_ssim && iou >= min_iou;
+			if (config.gated) {
+				passed = passed && ok;
+			}
+			std::cout << std::left << std::fixed << std::setprecision(2) << std::setw(18) << config.name << std::setw(22) << frame.name
+				<< std::setw(10) << ms << std::setw(8) << reference_ms / ms << std::setw(9) << psnr
+				<< std::setprecision(4) << std::setw(8) << ssim << std::setw(8) << iou
+				<< (config.gated ? (ok ? "[ OK ]" : "[FAIL]") : "[ -- ]") << std::endl;
+		}
+	}
+	return passed ? 0 : -1;
+}
+
+int main(int argc, char** argv) {
+	try {
+		if (argc > 1 && std::string(argv[1]) == "--suite") {
+			return run_suite(argc, argv);  // Машиночитаемый набор замеров этапов
+		}
+		if (argc > 1 && std::string(argv[1]) == "--golden") {
+			return run_golden(argc, argv);  // Эталонная регрессия качества
+		}
+
+		cv::Mat frame;
+		if (argc > 1) {
+			frame = cv::imread(argv[1], cv::IMREAD_COLOR);  // Кадр из файла
+			if (frame.empty()) {
+				std::cout << "- [FAIL] Cannot read image: " << argv[1] << std::endl;
+				return -1;
+			}
+			std::cout << "- [ OK ] Loaded frame: " << argv[1] << std::endl;
+		}
+		else {
+			frame = make_synthetic_frame(cv::Size(640, 480));  // Синтетический кадр
+			std::cout << "- [ OK ] Synthetic frame 640x480" << std::endl;
+		}
+
+		report_kmeans_sampling(frame, 8);
+		report_palette_lut(frame, 8, 5);
+		report_simd_assignment(frame);
+		report_specialized_kernels(frame);
+		report_bit_dilation(frame);
+		report_parallel_scaling(frame);
+		report_fused_output(frame);
+		report_incremental(frame);
+		report_batch_palette(frame);
+		report_reduced_tiers(frame);
+		bool passed = report_integer_kmeans(frame, 8);  // Допуск качества целочисленного k-means
+		report_median_cut(frame);
+		passed = report_steady_state_allocations(frame) && passed;  // Эффект не выделяет буферы в установившемся режиме
+		report_message_allocations(frame);
+		passed = report_outbox_drain() && passed;  // Outbox Worker'а отправляет результат, когда Composer снова читает
+		report_palette_codec(frame);
+		passed = report_pixel_formats(frame) && passed;  // Круг кодирования без потерь для всех форматов пикселей
+		return passed ? 0 : -1;
+	}
+	catch (const std::exception& e) {
+		std::cout << "- [FAIL] Benchmark error: " << e.what() << std::endl;
+		return -1;
+	}
+}
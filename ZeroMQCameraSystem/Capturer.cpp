@@ -3,6 +3,7 @@
 #include <zmq.hpp>
 #include <opencv2/opencv.hpp>
 #include "video_processing.pb.h"
+#include "frame_messages.hpp"
 #include ".\video_addresses.h"
 #include <chrono>
 #include <thread>
@@ -30,11 +31,14 @@ private:
 	std::queue<std::string> available_workers;  // Очередь доступных worker'ов
 	std::mutex queue_mutex;  // Мьютекс для защиты очередей от гонки данных
 	std::unordered_set<std::string> connected_workers;  // Множество подключенных worker'ов
+	frame_messages::EncodeBuffers encode_buffers;  // Буферы кодера и преобразования формата (переиспользуются между кадрами)
+	std::vector<int> compression_params;  // Параметры сжатия JPEG
 
 public:
 
 	Capturer() : context(1), router_socket(context, ZMQ_ROUTER),  // Создаем контекст и ROUTER сокет
-		frame_counter(0), max_queue_size(queue_size), dropped_frames(0), stop_requested(false) {  // Инициализация переменных
+		frame_counter(0), max_queue_size(queue_size), dropped_frames(0), stop_requested(false),  // Инициализация переменных
+		compression_params({ cv::IMWRITE_JPEG_QUALITY, cap_quality }) {
 
 		std::cout << "=== Capturer Initialization ===" << std::endl;
 		std::cout << "1. Available network interfaces:" << std::endl;
@@ -102,20 +106,11 @@ private:
 		message.set_sender_id(sender_id);  // Установка идентификатора отправителя
 		message.set_frame_type(video_processing::CAPTURED_FRAME);  // Установка типа кадра
 
-		// Кодируем изображение в JPEG для уменьшения размера
-		std::vector<uchar> buffer;  // Буфер для сжатых данных
-		std::vector<int> compression_params = { cv::IMWRITE_JPEG_QUALITY, cap_quality };  // Параметры сжатия (качество 80%)
-		cv::imencode(".jpg", frame, buffer, compression_params);  // Сжатие изображения в JPEG
+		// Кодируем изображение (proto_pixel_format, proto_image_encoding) прямо в поле изображения сообщения
+		frame_messages::encodeImageData(frame, compression_params, proto_pixel_format, proto_image_encoding,
+			encode_buffers, message.mutable_single_image());
 
-		// Заполняем данные изображения в сообщении
-		auto* image_data = message.mutable_single_image();  // Получаем указатель на поле изображения
-		image_data->set_width(frame.cols);  // Ширина изображения
-		image_data->set_height(frame.rows);  // Высота изображения
-		image_data->set_pixel_format(proto_pixel_format);  // Формат пикселей (BGR для OpenCV)
-		image_data->set_encoding(proto_image_encoding);  // Тип кодирования (JPEG)
-		image_data->set_image_data(buffer.data(), buffer.size());  // Данные изображения
-
-		return message;  // Возврат готового сообщения
+		return message;  // Возврат готового сообщения (без копии: NRVO)
 	}
 
 	// Получение текущего времени в секундах
@@ -151,7 +146,43 @@ private:
 
 					std::cout << "- [ OK ] Worker " << worker_id << " is ready for work" << std::endl;  // Логирование
 				}
+				// Worker уходит (drain): снимаем его запросы и подтверждаем - кадры, отправленные раньше,
+				// придут ему до подтверждения (порядок сообщений в одном соединении сохраняется)
+				else if (std::string(static_cast<char*>(request.data()), request.size()) == "BYE") {
+					release_worker(worker_id);
+				}
+			}
+		}
+	}
+
+	// Удаление Worker'а из очереди доступных и подтверждение "BYE"
+	void release_worker(const std::string& worker_id) {
+		size_t released = 0;  // Снятые запросы кадров
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex);  // Блокировка мьютекса
+			std::queue<std::string> remaining;  // Очередь без уходящего worker'а (порядок остальных сохраняется)
+			while (!available_workers.empty()) {
+				if (available_workers.front() == worker_id) {
+					released++;
+				}
+				else {
+					remaining.push(available_workers.front());
+				}
+				available_workers.pop();
 			}
+			available_workers.swap(remaining);
+			connected_workers.erase(worker_id);  // Worker больше не подключен
+		}
+
+		try {
+			zmq::message_t identity_msg(worker_id.data(), worker_id.size());  // Первая часть: идентификатор
+			router_socket.send(identity_msg, ZMQ_SNDMORE);
+			zmq::message_t ack_msg("BYE", 3);  // Вторая часть: подтверждение
+			router_socket.send(ack_msg, 0);
+			std::cout << "- [ OK ] Worker " << worker_id << " drained (" << released << " requests released)" << std::endl;
+		}
+		catch (const std::exception& e) {  // Worker мог уже отключиться
+			std::cout << "- [FAIL] Failed to acknowledge drain of " << worker_id << ": " << e.what() << std::endl;
 		}
 	}
 
@@ -164,17 +195,17 @@ private:
 			std::string worker_id = available_workers.front();  // Берем первого доступного worker'а
 			available_workers.pop();  // Удаляем его из очереди доступных
 
-			video_processing::VideoFrame frame = frame_queue.front();  // Берем первый кадр из очереди
+			video_processing::VideoFrame frame = std::move(frame_queue.front());  // Берем первый кадр из очереди
 			frame_queue.pop();  // Удаляем его из очереди
 
 			try {
-				std::string serialized = frame.SerializeAsString();  // Сериализация сообщения в строку
+				// Сериализация сразу в буфер сообщения ZeroMQ (без промежуточной строки)
+				zmq::message_t frame_msg(frame.ByteSizeLong());  // Вторая часть: данные кадра
+				frame.SerializeToArray(frame_msg.data(), static_cast<int>(frame_msg.size()));
 
 				// Отправляем кадр конкретному Worker'у (используем ZMQ_SNDMORE для multipart сообщения)
 				zmq::message_t identity_msg(worker_id.data(), worker_id.size());  // Первая часть: идентификатор
 				router_socket.send(identity_msg, ZMQ_SNDMORE);  // Отправка с флагом "есть еще данные"
-
-				zmq::message_t frame_msg(serialized.data(), serialized.size());  // Вторая часть: данные кадра
 				router_socket.send(frame_msg, 0);  // Отправка без флагов
 
 				std::cout << "- [ OK ] Sent frame " << frame.frame_id() << " to " << worker_id << std::endl;  // Логирование успеха
@@ -218,7 +249,7 @@ public:
 
 				{
 					std::lock_guard<std::mutex> lock(queue_mutex);  // Блокировка для добавления в очередь
-					frame_queue.push(video_frame);  // Добавление кадра в очередь
+					frame_queue.push(std::move(video_frame));  // Добавление кадра в очередь (перенос, без копии JPEG)
 					sent_frames++;  // Увеличение счетчика отправленных кадров
 				}
 
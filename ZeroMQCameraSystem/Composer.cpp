@@ -3,6 +3,7 @@
 #include <zmq.hpp>
 #include <opencv2/opencv.hpp>
 #include "video_processing.pb.h"
+#include "frame_messages.hpp"
 #include ".\video_addresses.h"
 #include <direct.h>
 #include <chrono>
@@ -19,14 +20,25 @@ private:
 	std::string composer_id; // Уникальный идентификатор компоновщика
 	std::string temp_original_dir; // Временная директория для исходных кадров
 	std::string temp_processed_dir; // Временная директория для обработанных кадров
-	cv::VideoWriter video_writer_original; // Видео-записыватель для исходного видео
-	cv::VideoWriter video_writer_processed; // Видео-записыватель для обработанного видео
-	uint64_t expected_frame_id; // Ожидаемый номер следующего кадра
-	uint64_t last_written_frame_id; // Номер последнего записанного кадра
-	uint64_t highest_received_frame_id; // Наибольший полученный номер кадра
-	std::map<uint64_t, std::pair<cv::Mat, cv::Mat>> frame_buffer; // Буфер кадров: frame_id -> (original, processed)
-	bool recording; // Флаг активности записи видео
-	cv::Size last_frame_size; // Размер последнего обработанного кадра
+
+	// Поток одного источника (Capturer'а): нумерация кадров у каждого Capturer'а своя,
+	// поэтому у каждого source_id свои буфер, ожидаемый кадр и видеофайлы
+	struct SourceStream {
+		std::string file_suffix; // Суффикс имен видеофайлов: "" у первого источника, "_2", "_3"... у следующих
+		cv::VideoWriter video_writer_original; // Видео-записыватель для исходного видео
+		cv::VideoWriter video_writer_processed; // Видео-записыватель для обработанного видео
+		uint64_t expected_frame_id = 0; // Ожидаемый номер следующего кадра
+		uint64_t last_written_frame_id = 0; // Номер последнего записанного кадра
+		uint64_t highest_received_frame_id = 0; // Наибольший полученный номер кадра
+		std::map<uint64_t, std::pair<cv::Mat, cv::Mat>> frame_buffer; // Буфер кадров: frame_id -> (original, processed)
+		bool recording = false; // Флаг активности записи видео
+		cv::Size last_frame_size; // Размер последнего обработанного кадра
+		uint64_t frames_received = 0; // Полученные кадры источника
+		uint64_t frames_written = 0; // Записанные кадры источника (вместе с черными)
+		uint64_t black_frames = 0; // Вставленные черные кадры источника
+	};
+
+	std::map<std::string, SourceStream> sources; // Потоки по source_id ("" - кадры без source_id)
 	std::chrono::steady_clock::time_point last_frame_time; // Время получения последнего кадра
 	bool first_frame_received; // Флаг получения первого кадра
 	uint64_t max_frame_gap; // Максимальный допустимый разрыв между кадрами
@@ -36,12 +48,12 @@ private:
 	std::atomic<uint64_t> total_frames_written; // Счетчик записанных кадров
 	std::atomic<bool> stop_requested; // Флаг запроса остановки
 	std::chrono::steady_clock::time_point start_time; // Время начала работы
-	uint64_t max_buffer_size; // Максимальный размер буфера кадров
+	uint64_t max_buffer_size; // Максимальный размер буфера кадров (у каждого источника)
+	video_processing::VideoFrame received_frame; // Переиспользуемое сообщение для разбора (строки сохраняют память)
 
 public:
 	Composer() : context(1), pull_socket(context, ZMQ_PULL), // Инициализация контекста и PULL-сокета
-		expected_frame_id(0), last_written_frame_id(0), highest_received_frame_id(0), // Инициализация счетчиков кадров
-		recording(false), first_frame_received(false), max_frame_gap(frame_gap), // Инициализация флагов и параметров
+		first_frame_received(false), max_frame_gap(frame_gap), // Инициализация флагов и параметров
 		total_frames_received(0), black_frames_inserted(0), // Инициализация атомарных счетчиков
 		total_frames_written(0), stop_requested(false), max_buffer_size(buffer_size) { // Инициализация остальных параметров
 
@@ -90,12 +102,22 @@ private:
 		return false; // Файл не существует
 	}
 
+	// Имя видеофайла источника: output_original.avi у первого, output_original_2.avi у второго и т.д.
+	static std::string video_path(const std::string& name, const std::string& suffix) {
+		return name + suffix + ".avi";
+	}
+
 	// Очистка старых видеофайлов
 	void cleanup_old_video_files() {
 		std::vector<std::string> video_files = { // Список видеофайлов для удаления
 			"output_original.avi", // Исходное видео
 			"output_processed.avi" // Обработанное видео
 		};
+		// Видео следующих источников прошлого запуска: output_original_2.avi, output_processed_2.avi, ...
+		for (int n = 2; file_exists(video_path("output_original", "_" + std::to_string(n))); n++) {
+			video_files.push_back(video_path("output_original", "_" + std::to_string(n)));
+			video_files.push_back(video_path("output_processed", "_" + std::to_string(n)));
+		}
 
 		std::cout << "=== Cleaning up old video files ===" << std::endl; // Заголовок очистки
 		int deleted_count = 0; // Счетчик удаленных файлов
@@ -117,129 +139,142 @@ private:
 		std::cout << "======================================================" << std::endl;
 	}
 
-	// Извлечение изображения из protobuf сообщения
+	// Извлечение изображения из protobuf сообщения: любые pixel_format и encoding, результат - BGR для cv::VideoWriter
 	cv::Mat extract_image(const video_processing::ImageData& image_data) {
-		const std::string& data = image_data.image_data(); // Получение данных изображения
-		std::vector<uchar> buffer(data.begin(), data.end()); // Создание буфера из строки
-
-		if (image_data.encoding() == proto_image_encoding) { // Если изображение в формате JPEG
-			return cv::imdecode(buffer, cv::IMREAD_COLOR); // Декодирование JPEG
+		cv::Mat image;
+		if (!frame_messages::decodeImageData(image_data, 1, true, image)) { // RAW - одна копия (или одно преобразование GRAY/RGB)
+			std::cout << "- [FAIL] Corrupted image (encoding " << image_data.encoding()
+				<< ", pixel format " << image_data.pixel_format() << ")" << std::endl;
+			return cv::Mat(); // Пустой кадр: пара не записывается
 		}
-		else { // Если сырые данные
-			return cv::Mat( // Создание матрицы OpenCV
-				image_data.height(), // Высота изображения
-				image_data.width(), // Ширина изображения
-				CV_8UC3, // Тип данных (3-канальное 8-битное)
-				(void*)data.data() // Указатель на данные
-			).clone(); // Клонирование матрицы
+		return image;
+	}
+
+	// Поток источника source_id; новый источник получает свои видеофайлы
+	SourceStream& source_stream(const std::string& source_id) {
+		auto it = sources.find(source_id);
+		if (it != sources.end()) {
+			return it->second;
 		}
+		SourceStream& stream = sources[source_id];
+		stream.file_suffix = sources.size() == 1 ? "" : "_" + std::to_string(sources.size()); // Первый источник - прежние имена файлов
+		std::cout << "- [ OK ] New source: " << (source_id.empty() ? "-" : source_id) << " -> "
+			<< video_path("output_processed", stream.file_suffix) << std::endl;
+		return stream;
 	}
 
 	// Инициализация видео-записывателей
-	void initialize_video_writers(const cv::Mat& first_frame) {
-		std::string video_original_path = "output_original.avi"; // Путь для исходного видео
-		std::string video_processed_path = "output_processed.avi"; // Путь для обработанного видео
+	void initialize_video_writers(SourceStream& stream, const cv::Mat& first_frame) {
+		std::string video_original_path = video_path("output_original", stream.file_suffix); // Путь для исходного видео
+		std::string video_processed_path = video_path("output_processed", stream.file_suffix); // Путь для обработанного видео
 
 		int fourcc = cv::VideoWriter::fourcc('M', 'J', 'P', 'G'); // Кодек MJPG
 		double fps = cap_fps; // Частота кадров
 		cv::Size frame_size(first_frame.cols, first_frame.rows); // Размер кадра
-		last_frame_size = frame_size; // Сохранение размера кадра
+		stream.last_frame_size = frame_size; // Сохранение размера кадра
 
-		video_writer_original.open(video_original_path, fourcc, fps, frame_size); // Открытие записи исходного видео
-		video_writer_processed.open(video_processed_path, fourcc, fps, frame_size); // Открытие записи обработанного видео
+		stream.video_writer_original.open(video_original_path, fourcc, fps, frame_size); // Открытие записи исходного видео
+		stream.video_writer_processed.open(video_processed_path, fourcc, fps, frame_size); // Открытие записи обработанного видео
 
-		if (video_writer_original.isOpened() && video_writer_processed.isOpened()) { // Проверка успешного открытия
-			recording = true; // Установка флага записи
-			std::cout << "- [ OK ] Video recording started: " << fps << " FPS, " // Сообщение о начале записи
+		if (stream.video_writer_original.isOpened() && stream.video_writer_processed.isOpened()) { // Проверка успешного открытия
+			stream.recording = true; // Установка флага записи
+			std::cout << "- [ OK ] Video recording started: " << video_processed_path << ", " << fps << " FPS, " // Сообщение о начале записи
 				<< frame_size.width << "x" << frame_size.height << std::endl; // Информация о размере
 		}
 	}
 
 	// Вставка черного кадра для пропущенных кадров
-	void insert_black_frame(uint64_t frame_id) {
-		if (!recording || last_frame_size.width == 0) return; // Проверка возможности записи
+	void insert_black_frame(SourceStream& stream, uint64_t frame_id) {
+		if (!stream.recording || stream.last_frame_size.width == 0) return; // Проверка возможности записи
 
-		cv::Mat black_frame = cv::Mat::zeros(last_frame_size, CV_8UC3); // Создание черного кадра
+		cv::Mat black_frame = cv::Mat::zeros(stream.last_frame_size, CV_8UC3); // Создание черного кадра
 		std::string text = "MISSING FRAME " + std::to_string(frame_id); // Текст для отображения
 		cv::putText(black_frame, text, // Добавление текста на кадр
-			cv::Point(50, last_frame_size.height / 2), // Позиция текста
+			cv::Point(50, stream.last_frame_size.height / 2), // Позиция текста
 			cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(255, 255, 255), 2); // Параметры текста
 
-		video_writer_original.write(black_frame); // Запись черного кадра в исходное видео
-		video_writer_processed.write(black_frame); // Запись черного кадра в обработанное видео
+		stream.video_writer_original.write(black_frame); // Запись черного кадра в исходное видео
+		stream.video_writer_processed.write(black_frame); // Запись черного кадра в обработанное видео
 		total_frames_written++; // Увеличение счетчика записанных кадров
-		last_written_frame_id = frame_id; // Обновление последнего записанного кадра
+		stream.frames_written++;
+		stream.black_frames++;
+		stream.last_written_frame_id = frame_id; // Обновление последнего записанного кадра
 
 		std::cout << "- [ -- ] Inserted black frame: " << frame_id << std::endl; // Сообщение о вставке
 	}
 
 	// Основная функция записи - пытается записать как можно больше кадров
-	void write_available_frames() {
-		if (frame_buffer.empty() || !recording) return; // Проверка наличия кадров и активности записи
+	void write_available_frames(SourceStream& stream) {
+		if (stream.frame_buffer.empty() || !stream.recording) return; // Проверка наличия кадров и активности записи
 
 		bool wrote_any_frame = false; // Флаг записи хотя бы одного кадра
 
 		// Пытаемся записать все доступные кадры начиная с expected_frame_id
-		while (frame_buffer.find(expected_frame_id) != frame_buffer.end()) { // Пока есть ожидаемый кадр
-			auto& frames = frame_buffer[expected_frame_id]; // Получение кадра из буфера
+		while (stream.frame_buffer.find(stream.expected_frame_id) != stream.frame_buffer.end()) { // Пока есть ожидаемый кадр
+			auto& frames = stream.frame_buffer[stream.expected_frame_id]; // Получение кадра из буфера
 
-			video_writer_original.write(frames.first); // Запись исходного кадра
-			video_writer_processed.write(frames.second); // Запись обработанного кадра
+			stream.video_writer_original.write(frames.first); // Запись исходного кадра
+			stream.video_writer_processed.write(frames.second); // Запись обработанного кадра
 			total_frames_written++; // Увеличение счетчика
-			last_written_frame_id = expected_frame_id; // Обновление последнего записанного кадра
+			stream.frames_written++;
+			stream.last_written_frame_id = stream.expected_frame_id; // Обновление последнего записанного кадра
 
-			frame_buffer.erase(expected_frame_id); // Удаление кадра из буфера
-			expected_frame_id++; // Увеличение ожидаемого номера кадра
+			stream.frame_buffer.erase(stream.expected_frame_id); // Удаление кадра из буфера
+			stream.expected_frame_id++; // Увеличение ожидаемого номера кадра
 			wrote_any_frame = true; // Установка флага записи
 
-			if (expected_frame_id) { // Периодическое сообщение ...% 50 == 0
-				std::cout << "- [ OK ] Written to video: frame " << (expected_frame_id - 1) // Сообщение о записи
-					<< " (buffer: " << frame_buffer.size() << ")" << std::endl; // Информация о размере буфера
+			if (stream.expected_frame_id) { // Периодическое сообщение ...% 50 == 0
+				std::cout << "- [ OK ] Written to video: frame " << (stream.expected_frame_id - 1) // Сообщение о записи
+					<< " (buffer: " << stream.frame_buffer.size() << ")" << std::endl; // Информация о размере буфера
 			}
 		}
 
 		// Если мы что-то записали, проверяем не нужно ли вставить черные кадры
 		if (wrote_any_frame) {
-			check_for_missing_frames_conservative(); // Проверка пропусков
+			check_for_missing_frames_conservative(stream); // Проверка пропусков
 		}
 	}
 
 	// Консервативная проверка пропусков - вставляет черные кадры только при явных разрывах
-	void check_for_missing_frames_conservative() {
-		if (frame_buffer.empty()) return; // Проверка наличия кадров в буфере
+	void check_for_missing_frames_conservative(SourceStream& stream) {
+		if (stream.frame_buffer.empty()) return; // Проверка наличия кадров в буфере
 
 		// Находим минимальный frame_id в буфере
-		uint64_t min_buffered_id = frame_buffer.begin()->first; // Первый (минимальный) кадр в буфере
+		uint64_t min_buffered_id = stream.frame_buffer.begin()->first; // Первый (минимальный) кадр в буфере
 
 		// Вычисляем разрыв
-		uint64_t gap = min_buffered_id - expected_frame_id; // Разрыв между ожидаемым и минимальным в буфере
+		uint64_t gap = min_buffered_id - stream.expected_frame_id; // Разрыв между ожидаемым и минимальным в буфере
 
 		// Вставляем черные кадры только если:
 		// 1. Очень большой разрыв (больше max_frame_gap)
 		// 2. И в буфере есть кадры с намного большими номерами (значит это не временная задержка)
 		if (gap > max_frame_gap) { // Проверка на большой разрыв
-			uint64_t max_buffered_id = frame_buffer.rbegin()->first; // Максимальный кадр в буфере
+			uint64_t max_buffered_id = stream.frame_buffer.rbegin()->first; // Максимальный кадр в буфере
 
 			// Если максимальный кадр в буфере намного больше минимального, 
 			// значит мы действительно пропустили кадры
 			if (max_buffered_id - min_buffered_id > max_frame_gap + 20) { // Проверка разброса в буфере
 				std::cout << "- [ -- ] Large gap detected: " << gap << " frames from " // Сообщение о большом разрыве
-					<< expected_frame_id << " to " << (min_buffered_id - 1) << std::endl;
+					<< stream.expected_frame_id << " to " << (min_buffered_id - 1) << std::endl;
 
-				for (uint64_t frame_id = expected_frame_id; frame_id < min_buffered_id; frame_id++) { // Цикл по пропущенным кадрам
-					insert_black_frame(frame_id); // Вставка черного кадра
+				for (uint64_t frame_id = stream.expected_frame_id; frame_id < min_buffered_id; frame_id++) { // Цикл по пропущенным кадрам
+					insert_black_frame(stream, frame_id); // Вставка черного кадра
 					black_frames_inserted++; // Увеличение счетчика черных кадров
 				}
-				expected_frame_id = min_buffered_id; // Обновление ожидаемого кадра
+				stream.expected_frame_id = min_buffered_id; // Обновление ожидаемого кадра
 
 				// После вставки черных кадров пытаемся записать дальше
-				write_available_frames(); // Продолжение записи
+				write_available_frames(stream); // Продолжение записи
 			}
 		}
 	}
 
 	// Обработка полученного кадра для видео
 	void process_frame_for_video(const video_processing::VideoFrame& frame) {
+		// Worker с несколькими Capturer'ами (worker_capturer_fan_in) присылает кадры разных камер, нумерация
+		// кадров у каждого Capturer'а своя: кадр идет в поток своего source_id (свои буфер и видеофайлы)
+		SourceStream& stream = source_stream(frame.source_id());
+		stream.frames_received++;
 		last_frame_received_time = std::chrono::steady_clock::now(); // Обновление времени получения
 
 		if (frame.has_image_pair()) { // Проверка наличия пары изображений
@@ -255,34 +290,34 @@ private:
 					std::cout << "- [ OK ] First frame received: " << frame.frame_id() << std::endl; // Сообщение
 				}
 
-				if (!recording) { // Если запись еще не начата
-					initialize_video_writers(original_image); // Инициализация записи
+				if (!stream.recording) { // Если запись еще не начата
+					initialize_video_writers(stream, original_image); // Инициализация записи
 				}
 
 				uint64_t received_frame_id = frame.frame_id(); // Получение номера кадра
 
 				// Всегда обновляем highest_received_frame_id
-				if (received_frame_id > highest_received_frame_id) { // Если кадр новее
-					highest_received_frame_id = received_frame_id; // Обновление максимального номера
+				if (received_frame_id > stream.highest_received_frame_id) { // Если кадр новее
+					stream.highest_received_frame_id = received_frame_id; // Обновление максимального номера
 				}
 
 				// Никогда не пропускаем старые кадры - сохраняем все!
-				if (received_frame_id < expected_frame_id) { // Если кадр устаревший
+				if (received_frame_id < stream.expected_frame_id) { // Если кадр устаревший
 					// Кадр устарел, но мы его все равно сохраняем в буфер
 					std::cout << "- [ -- ] Late frame: " << received_frame_id // Сообщение об опоздавшем кадре
-						<< " (expected: " << expected_frame_id << ")" << std::endl;
+						<< " (expected: " << stream.expected_frame_id << ")" << std::endl;
 				}
 
 				// Сохраняем в буфер
-				if (frame_buffer.size() < max_buffer_size) { // Проверка переполнения буфера
-					frame_buffer[received_frame_id] = std::make_pair(original_image, processed_image); // Сохранение в буфер
+				if (stream.frame_buffer.size() < max_buffer_size) { // Проверка переполнения буфера
+					stream.frame_buffer[received_frame_id] = std::make_pair(original_image, processed_image); // Сохранение в буфер
 
 					std::cout << "- [ OK ] Received frame: " << received_frame_id // Сообщение о получении
-						<< " (highest: " << highest_received_frame_id // Информация о максимальном номере
-						<< ", buffer: " << frame_buffer.size() << ")" << std::endl; // Информация о размере буфера
+						<< " (highest: " << stream.highest_received_frame_id // Информация о максимальном номере
+						<< ", buffer: " << stream.frame_buffer.size() << ")" << std::endl; // Информация о размере буфера
 
 					// Пытаемся записать доступные кадры
-					write_available_frames(); // Запись доступных кадров
+					write_available_frames(stream); // Запись доступных кадров
 				}
 			}
 		}
@@ -308,53 +343,71 @@ private:
 	void show_statistics() {
 		auto now = std::chrono::steady_clock::now(); // Текущее время
 
+		size_t buffered = 0; // Кадры в буферах всех источников
+		for (const auto& source : sources) {
+			buffered += source.second.frame_buffer.size();
+		}
 		std::cout << "=== Composer stats: " // Вывод статистики
 			<< total_frames_received << " received, " // Полученные кадры
 			<< total_frames_written << " written, " // Записанные кадры
 			<< black_frames_inserted << " black inserted, " // Вставленные черные кадры
-			<< frame_buffer.size() << " buffered, " // Кадры в буфере
-			<< "expected: " << expected_frame_id << ", " // Ожидаемый кадр
-			<< "highest: " << highest_received_frame_id << ", " // Максимальный полученный
+			<< buffered << " buffered, " // Кадры в буфере
+			<< sources.size() << " sources" // Источники (Capturer'ы)
 			<< std::fixed << std::setprecision(1) << "" << std::endl; // FPS
+		for (const auto& source : sources) { // Нумерация у каждого источника своя
+			const SourceStream& stream = source.second;
+			std::cout << "=== Composer source " << (source.first.empty() ? "-" : source.first) << ": "
+				<< stream.frames_received << " received, " << stream.frames_written << " written, "
+				<< stream.black_frames << " black, " << stream.frame_buffer.size() << " buffered, "
+				<< "expected: " << stream.expected_frame_id << ", highest: " << stream.highest_received_frame_id
+				<< " -> " << video_path("output_processed", stream.file_suffix) << std::endl;
+		}
 	}
 
 	// Финальная обработка оставшихся кадров
 	void final_processing() {
 		std::cout << "- [ OK ] Final processing: writing all remaining frames..." << std::endl; // Сообщение
+		for (auto& source : sources) {
+			write_buffered_frames(source.second); // Запись всех кадров буфера источника
+		}
+	}
 
+	// Запись всех кадров буфера по порядку, пропуски заполняются черными кадрами
+	void write_buffered_frames(SourceStream& stream) {
 		// Сначала записываем все последовательные кадры
-		write_available_frames(); // Запись доступных кадров
+		write_available_frames(stream); // Запись доступных кадров
 
 		// Если в буфере еще остались кадры (не последовательные)
-		if (!frame_buffer.empty()) { // Проверка наличия кадров в буфере
-			std::cout << "- [ -- ] Processing " << frame_buffer.size() << " remaining frames in buffer..." << std::endl; // Сообщение
+		if (!stream.frame_buffer.empty()) { // Проверка наличия кадров в буфере
+			std::cout << "- [ -- ] Processing " << stream.frame_buffer.size() << " remaining frames in buffer..." << std::endl; // Сообщение
 
 			// Создаем временную карту для сортировки (она уже отсортирована по frame_id)
 			// Проходим по всем кадрам в буфере по порядку
-			for (auto it = frame_buffer.begin(); it != frame_buffer.end(); ++it) { // Цикл по буферу
+			for (auto it = stream.frame_buffer.begin(); it != stream.frame_buffer.end(); ++it) { // Цикл по буферу
 				uint64_t frame_id = it->first; // Номер кадра
 				std::pair<cv::Mat, cv::Mat>& frames = it->second; // Пара изображений
 
 				// Вставляем черные кадры для пропусков до этого кадра
-				while (expected_frame_id < frame_id) { // Пока есть пропуски
-					insert_black_frame(expected_frame_id); // Вставка черного кадра
+				while (stream.expected_frame_id < frame_id) { // Пока есть пропуски
+					insert_black_frame(stream, stream.expected_frame_id); // Вставка черного кадра
 					black_frames_inserted++; // Увеличение счетчика
-					expected_frame_id++; // Увеличение ожидаемого номера
+					stream.expected_frame_id++; // Увеличение ожидаемого номера
 				}
 
 				// Записываем сам кадр
-				if (recording) { // Если запись активна
-					video_writer_original.write(frames.first); // Запись исходного
-					video_writer_processed.write(frames.second); // Запись обработанного
+				if (stream.recording) { // Если запись активна
+					stream.video_writer_original.write(frames.first); // Запись исходного
+					stream.video_writer_processed.write(frames.second); // Запись обработанного
 					total_frames_written++; // Увеличение счетчика
-					last_written_frame_id = frame_id; // Обновление последнего записанного
+					stream.frames_written++;
+					stream.last_written_frame_id = frame_id; // Обновление последнего записанного
 				}
-				expected_frame_id = frame_id + 1; // Обновление ожидаемого номера
+				stream.expected_frame_id = frame_id + 1; // Обновление ожидаемого номера
 
 				std::cout << "- [ OK ] Final write: frame " << frame_id << std::endl; // Сообщение о записи
 			}
 
-			frame_buffer.clear(); // Очистка буфера
+			stream.frame_buffer.clear(); // Очистка буфера
 		}
 
 	}
@@ -374,9 +427,8 @@ public:
 
 				if (items[0].revents & ZMQ_POLLIN) { // Если есть данные для чтения
 					if (pull_socket.recv(&message, ZMQ_DONTWAIT)) { // Неблокирующее чтение
-						video_processing::VideoFrame frame; // Создание объекта кадра
-						if (frame.ParseFromArray(message.data(), message.size())) { // Парсинг protobuf сообщения
-							process_frame_for_video(frame); // Обработка кадра
+						if (received_frame.ParseFromArray(message.data(), message.size())) { // Парсинг в переиспользуемое сообщение
+							process_frame_for_video(received_frame); // Обработка кадра
 							total_frames_received++; // Увеличение счетчика полученных кадров
 						}
 					}
@@ -384,7 +436,9 @@ public:
 
 				// Периодически пытаемся записать кадры (даже если нет новых сообщений) ...% 20 == 0
 				if (total_frames_received) { // Каждые 20 кадров
-					write_available_frames(); // Запись доступных кадров
+					for (auto& source : sources) {
+						write_available_frames(source.second); // Запись доступных кадров
+					}
 				}
 
 				if (total_frames_received % 50 == 0 && total_frames_received > 0) { // Каждые 50 кадров
@@ -419,7 +473,12 @@ public:
 		std::cout << "Total frames received: " << total_frames_received << std::endl; // Итоговая статистика
 		std::cout << "Total frames written: " << total_frames_written << std::endl; // Записанные кадры
 		std::cout << "Black frames inserted: " << black_frames_inserted << std::endl; // Черные кадры
-		std::cout << "Frames remaining in buffer: " << frame_buffer.size() << std::endl; // Оставшиеся в буфере
+		size_t remaining = 0; // Оставшиеся в буферах всех источников
+		for (const auto& source : sources) {
+			remaining += source.second.frame_buffer.size();
+		}
+		std::cout << "Frames remaining in buffer: " << remaining << std::endl; // Оставшиеся в буфере
+		std::cout << "Sources recorded: " << sources.size() << std::endl; // Источники, у каждого свои видеофайлы
 
 		if (total_frames_written > 0) { // Если были записаны кадры
 			double black_rate = (double)black_frames_inserted / total_frames_written * 100; // Расчет процента черных кадров
@@ -429,10 +488,14 @@ public:
 			std::cout << "Average FPS: " << std::fixed << std::setprecision(1) << fps << std::endl; // Вывод FPS
 		}
 
-		if (recording) { // Если запись была активна
-			video_writer_original.release(); // Закрытие исходного видео
-			video_writer_processed.release(); // Закрытие обработанного видео
-			std::cout << "Video files finalized" << std::endl; // Сообщение
+		for (auto& source : sources) {
+			SourceStream& stream = source.second;
+			if (stream.recording) { // Если запись была активна
+				stream.video_writer_original.release(); // Закрытие исходного видео
+				stream.video_writer_processed.release(); // Закрытие обработанного видео
+				std::cout << "Video files finalized: " << video_path("output_original", stream.file_suffix) << ", "
+					<< video_path("output_processed", stream.file_suffix) << std::endl; // Сообщение
+			}
 		}
 
 		std::cout << "=== Thank you for using ZeroMQ Camera System ===" << std::endl; // Завершающее сообщение
@@ -4,34 +4,97 @@
 #include <opencv2/opencv.hpp>
 #include "video_processing.pb.h"
 #include "scanner_darkly_effect.hpp"
+#include "incremental_effect.hpp"
+#include "effect_pipeline.hpp"
+#include "latency_controller.hpp"
+#include "result_cache.hpp"
+#include "result_outbox.hpp"
+#include "frame_messages.hpp"
+#include "cpu_affinity.hpp"
 #include ".\video_addresses.h"
 #include <direct.h>
 #include <chrono>
 #include <iomanip>
 #include <thread>
 #include <atomic>
+#include <memory>
 #include <process.h> // Для _getpid
+#include <windows.h> // Для SetConsoleCtrlHandler
+
+// Запрос плавной остановки (drain) от обработчика консоли: Ctrl+C, Ctrl+Break, закрытие окна
+std::atomic<bool> g_drain_requested(false);
+std::atomic<bool> g_drain_finished(false);  // Drain завершен: обработчик закрытия окна может вернуть управление
 
 class Worker {
 private:
+    // Подключение к одному Capturer'у: свой DEALER и свой кредит запросов
+    struct CapturerLink {
+        std::unique_ptr<zmq::socket_t> socket;  // DEALER сокет к Capturer'у
+        std::string address;      // Адрес Capturer'а
+        int outstanding = 0;      // Отправленные GET, на которые кадр еще не пришел
+        uint64_t received = 0;    // Получено кадров от этого Capturer'а
+        bool drained = false;     // Capturer подтвердил уход ("BYE"): кадров от него больше не будет
+        std::string stream_id;    // sender_id последнего кадра (состояние потока в инкрементальном режиме)
+    };
+
+    // Кадр пакета (worker_batch_max): сообщение переиспользуется между пакетами
+    struct BatchItem {
+        video_processing::VideoFrame frame;  // Входной кадр
+        cv::Mat image;            // Декодированное изображение (пусто - кадр уже отправлен из кэша или с ошибкой)
+        uint64_t cache_key = 0;   // Ключ кэша результатов
+        uint64_t cache_phash = 0; // dHash входа (0 - не считался)
+        bool grouped = false;     // Кадр уже отнесен к группе своего потока
+    };
+
     zmq::context_t context;  // Контекст ZeroMQ для управления сокетами
-    zmq::socket_t dealer_socket;  // DEALER сокет для подключения к Capturer
+    std::vector<CapturerLink> capturers;  // Capturer'ы, от которых Worker получает кадры
+    std::vector<zmq::pollitem_t> poll_items;  // Опрос DEALER сокетов всех Capturer'ов и, последним, PUSH в Composer (POLLOUT)
+    size_t next_capturer;         // С какого Capturer'а начинать опрос (круговой обход - поровну между источниками)
     zmq::socket_t push_socket;    // PUSH сокет для отправки результатов в Composer
     std::string worker_id;        // Уникальный идентификатор Worker'а
     //std::string temp_dir;         // Временная директория для сохранения файлов
     ScannerDarklyEffect effect;   // Объект для применения визуального эффекта
-    std::string capturer_address; // Адрес Capturer'а
+    cv::Mat processed_image;      // Буфер обработанного кадра (переиспользуется, пока размер кадра не меняется)
+    IncrementalEffect incremental; // Пересчет только измененных плиток (effect_incremental)
+    double recomputed_tiles_sum;  // Сумма долей пересчитанных плиток (для средней в статистике)
+    EffectRegistry effect_registry; // Этапы эффектов, доступные для effect_chain
+    EffectChain effect_chain;     // Цепочка этапов из config.txt (по умолчанию - только scanner_darkly)
     std::string composer_address; // Адрес Composer'а
     uint64_t processed_count;     // Счетчик успешно обработанных кадров
     uint64_t failed_count;        // Счетчик неудачных обработок
     std::chrono::steady_clock::time_point start_time; // Время начала работы
     std::atomic<bool> stop_requested; // Флаг для запроса остановки
+    int processing_tier;          // Уровень обработки: 0 - полное разрешение, 1 - 1/2, 2 - 1/4 (читается на каждом кадре)
+    LatencyController latency;    // Регулятор задержки: ступень настроек по времени эффекта (worker_latency_budget_ms)
+    double effect_ms_sum;         // Суммарное время эффекта (для среднего в статистике)
+    ResultCache result_cache;     // Готовые результаты для повторяющихся входных кадров (worker_cache_entries)
+    video_processing::VideoFrame output_frame; // Сообщение для Composer'а (переиспользуется: строки и вложенные сообщения не выделяются заново)
+    frame_messages::EncodeBuffers encode_buffers;  // Буферы кодера и преобразования формата (переиспользуются между кадрами)
+    std::vector<int> compression_params;  // Параметры сжатия JPEG
+    bool draining;                // Идет drain: новые кадры не запрашиваются, полученные дорабатываются
+    std::chrono::steady_clock::time_point drain_start; // Начало drain (для worker_drain_timeout_ms)
+    CpuPlacement& placement;      // Размещение на ядрах (выполнено в main до создания контекста ZeroMQ)
+    std::vector<BatchItem> batch; // Пакет кадров, уже пришедших от Capturer'ов (worker_batch_max)
+    std::vector<size_t> batch_group;  // Номера кадров пакета из одного потока
+    std::vector<cv::Mat> batch_images;  // Изображения группы для общей палитры
+    uint64_t batch_count;         // Обработано пакетов
+    uint64_t batch_frames;        // Кадров в этих пакетах (средний размер пакета - в статистике)
+    ResultOutbox outbox;          // Результаты, не принятые PUSH сокетом (очередь Composer'а заполнена)
+    uint64_t requests_withheld;   // Раз, когда запрос кадров отложен из-за полного outbox
+    bool requests_paused;         // Запросы отложены: возобновятся, когда outbox освободится
 
 public:
-    Worker() : context(1),  // Инициализация контекста ZeroMQ с 1 IO thread
-        dealer_socket(context, ZMQ_DEALER),  // Инициализация DEALER сокета
+    // Поток ввода-вывода ZeroMQ создается контекстом и наследует маску процесса из placement
+    explicit Worker(CpuPlacement& cpu_placement) : context(1),  // Инициализация контекста ZeroMQ с 1 IO thread
+        next_capturer(0),
         push_socket(context, ZMQ_PUSH),      // Инициализация PUSH сокета
-        processed_count(0), failed_count(0), stop_requested(false) { // Инициализация счетчиков и флагов
+        incremental(effect), recomputed_tiles_sum(0.0),  // Инкрементальный режим использует эффект Worker'а
+        processed_count(0), failed_count(0), stop_requested(false), processing_tier(0), // Инициализация счетчиков и флагов
+        latency(worker_latency_budget_ms, worker_latency_window), effect_ms_sum(0.0),
+        result_cache(worker_cache_entries, worker_cache_phash_distance),
+        compression_params({ cv::IMWRITE_JPEG_QUALITY, cap_quality }), draining(false), placement(cpu_placement),
+        batch_count(0), batch_frames(0), outbox(worker_outbox_size),
+        requests_withheld(0), requests_paused(false) {
 
         std::cout << "=== Worker Initialization ===" << std::endl;
         std::cout << "1. Available capturer network interfaces:" << std::endl;
@@ -40,26 +103,36 @@ public:
         worker_id = "worker_" + std::to_string(_getpid()) + "_" +  // Базовый ID с PID
             std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()); // Добавляем временную метку
 
-        // Устанавливаем идентификатор для DEALER сокета
-        dealer_socket.setsockopt(ZMQ_IDENTITY, worker_id.c_str(), worker_id.size());
+        // Подключение к Capturer (DEALER): к первому доступному адресу или, при worker_capturer_fan_in,
+        // к каждому адресу своим сокетом
+        for (const auto& address : worker_to_capturer_connect_addresses) {
+            CapturerLink link;
+            link.socket.reset(new zmq::socket_t(context, ZMQ_DEALER));
+            link.address = address;
 
-        // Настраиваем High Water Mark (максимальный размер очереди)
-        int rcvhwm = 1;  // Маленький буфер - берем задания когда готовы
-        dealer_socket.setsockopt(ZMQ_RCVHWM, &rcvhwm, sizeof(rcvhwm));
+            // Устанавливаем идентификатор для DEALER сокета
+            link.socket->setsockopt(ZMQ_IDENTITY, worker_id.c_str(), worker_id.size());
 
-        // Подключение к Capturer (DEALER)
-        // Попытка подключения к одному из адресов
-        for (const auto& address : worker_to_capturer_connect_addresses) {
+            // Настраиваем High Water Mark (максимальный размер очереди)
+            int rcvhwm = std::max(1, std::max(worker_capturer_credit, worker_batch_max));  // Маленький буфер - не больше наибольшего кредита
+            link.socket->setsockopt(ZMQ_RCVHWM, &rcvhwm, sizeof(rcvhwm));
             try {
-                dealer_socket.connect(address);  // Пытаемся подключиться
-                capturer_address = address;      // Сохраняем успешный адрес
+                link.socket->connect(address);  // Пытаемся подключиться
                 std::cout << "- [ OK ] DEALER connected to Capturer: " << address << std::endl;
-                break;  // Выходим из цикла при успешном подключении
             }
             catch (const zmq::error_t& e) {  // Обработка ошибок подключения
                 std::cout << "- [FAIL] Failed to connect DEALER to " << address << ": " << e.what() << std::endl;
+                continue;
             }
+            capturers.push_back(std::move(link));
+            if (!worker_capturer_fan_in) {
+                break;  // Выходим из цикла при успешном подключении
+            }
+        }
+        for (auto& link : capturers) {
+            poll_items.push_back({ static_cast<void*>(*link.socket), 0, ZMQ_POLLIN, 0 });
         }
+        poll_items.push_back({ static_cast<void*>(push_socket), 0, 0, 0 });  // POLLOUT - только пока outbox не пуст
 
         // Подключение к Composer (PUSH)
        for (const auto& address : worker_to_composer_connect_addresses) {
@@ -80,6 +153,40 @@ public:
         effect.setDilationKernelSize(effect_dilation_kernel_size);           // Размер ядра дилатации (0 = нет дилатации)
         effect.setColorQuantizationLevels(effect_color_quantization_levels);      // Уровни квантования цвета
         effect.setBlackContours(effect_black_contours);             // Использовать черные контуры
+        effect.setKMeansSampling(effect_kmeans_sample_percent, effect_kmeans_random_sampling);  // Подвыборка для обучения k-means
+        effect.setPaletteLut(effect_palette_lut);                   // LUT 32x32x32 для назначения цветов
+        effect.setParallelStrips(effect_parallel_strips);           // Параллельная обработка полосами
+        effect.setIntegerKMeans(effect_kmeans_integer);             // Целочисленный k-means без CV_32F
+        effect.setMedianCutPalette(effect_median_cut);              // Детерминированная палитра median cut
+        incremental.setTileSize(effect_incremental_tile);           // Размер плитки инкрементального режима
+        incremental.setThreshold(effect_incremental_threshold);     // Порог изменения плитки
+        incremental.setRefreshInterval(effect_incremental_refresh); // Период полного пересчета
+        incremental.setIdleTimeout(effect_incremental_idle_ms);     // Удаление состояния потока без кадров
+        if (latency.enabled()) {
+            std::cout << "- [ OK ] Latency budget: " << latency.budgetMs() << " ms per frame" << std::endl;
+        }
+        if (placement.active()) {
+            std::cout << "- [ OK ] CPU placement: " << placement.describe() << std::endl;
+        }
+        if (result_cache.enabled()) {
+            std::cout << "- [ OK ] Result cache: " << worker_cache_entries << " entries"
+                << (result_cache.perceptual() ? ", dHash distance " + std::to_string(worker_cache_phash_distance) : "") << std::endl;
+        }
+
+        // Сборка цепочки эффектов по effect_chain
+        register_effect_stages();
+        try {
+            effect_chain.build(effect_chain_stages, effect_registry);
+        }
+        catch (const std::exception& e) {  // Неизвестный этап - работаем с эффектом по умолчанию
+            std::cout << "- [FAIL] Invalid effect_chain: " << e.what() << ", using scanner_darkly" << std::endl;
+            effect_chain.build({ "scanner_darkly" }, effect_registry);
+        }
+        set_processing_tier(effect_processing_tier);  // Начальный уровень обработки (быстрый - уменьшенный кадр), после сборки цепочки
+        if (!scanner_darkly_only() && (effect_processing_tier > 0 || effect_incremental || latency.enabled())) {
+            std::cout << "- [ -- ] effect_chain is not scanner_darkly: reduced tiers, incremental mode and latency tiers "
+                << "do not apply" << std::endl;
+        }
 
         start_time = std::chrono::steady_clock::now();  // Запоминаем время начала
 
@@ -94,49 +201,92 @@ public:
         stop_requested = true;  // Устанавливаем флаг остановки
     }
 
+    // Смена уровня обработки без перезапуска: действует со следующего кадра. Быстрые уровни - только для
+    // scanner_darkly (другие этапы effect_chain выполняются на полном кадре, как заданы)
+    void set_processing_tier(int tier) {
+        processing_tier = scanner_darkly_only() ? std::max(0, std::min(tier, 2)) : 0;  // 0 - полный, 1 - IMREAD_REDUCED_COLOR_2, 2 - IMREAD_REDUCED_COLOR_4
+    }
+
 private:
-    // Извлечение изображения из protobuf сообщения
-    cv::Mat extract_image(const video_processing::ImageData& image_data) {
-        const std::string& data = image_data.image_data();  // Получаем бинарные данные
-        std::vector<uchar> buffer(data.begin(), data.end());  // Конвертируем в вектор байт
-
-        // Проверяем формат кодирования
-        if (image_data.encoding() == proto_image_encoding) {
-            // Декодируем JPEG изображение
-            cv::Mat decoded = cv::imdecode(buffer, cv::IMREAD_COLOR);
-            if (decoded.empty()) {  // Проверяем успешность декодирования
-                throw std::runtime_error("- [FAIL] Failed to decode JPEG image");
-            }
-            return decoded;  // Возвращаем декодированное изображение
-        }
-        else {
-            // Для RAW формата создаем матрицу из бинарных данных
-            return cv::Mat(
-                image_data.height(),    // Высота изображения
-                image_data.width(),     // Ширина изображения  
-                CV_8UC3,                // Формат: 3 канала по 8 бит
-                (void*)data.data()      // Указатель на данные
-            ).clone();  // Создаем копию данных
-        }
+    // Настройки текущей ступени регулятора задержки: ступень только ограничивает значения из config.txt
+    void apply_latency_tier() {
+        const LatencyController::Tier& tier = latency.settings();
+        effect.setKMeansIterations(tier.kmeans_iterations, tier.kmeans_attempts);
+        effect.setKMeansSampling(std::min(effect_kmeans_sample_percent, tier.sample_percent), effect_kmeans_random_sampling);
+        set_processing_tier(std::max(effect_processing_tier, tier.scale_tier));
+        std::cout << "- [ -- ] " << worker_id << " latency tier " << latency.tier()
+            << " (avg " << std::fixed << std::setprecision(1) << latency.lastAverageMs() << " ms, budget "
+            << latency.budgetMs() << " ms): k-means " << tier.kmeans_iterations << " iter x " << tier.kmeans_attempts
+            << ", sample " << std::min(effect_kmeans_sample_percent, tier.sample_percent) << "%, scale 1/"
+            << (1 << processing_tier) << std::endl;
+    }
+
+    // Регистрация этапов для effect_chain (параметр "имя:число", -1 - значение из config.txt)
+    void register_effect_stages() {
+        effect_registry.add("scanner_darkly", [this](int) {
+            return std::unique_ptr<EffectStage>(new ScannerDarklyStage(effect));  // Эффект Worker'а со всеми настройками effect_*
+        });
+        effect_registry.add("posterize", [](int bits) {
+            return std::unique_ptr<EffectStage>(new PosterizeStage(bits < 0 ? effect_posterize_bits : bits));
+        });
+        effect_registry.add("edges", [](int) {
+            return std::unique_ptr<EffectStage>(new EdgesStage(effect_canny_low_threshold, effect_canny_high_threshold,
+                effect_gaussian_kernel_size));
+        });
+        effect_registry.add("overlay", [](int) {
+            return std::unique_ptr<EffectStage>(new OverlayStage(effect_black_contours));
+        });
+        effect_registry.add("resize", [](int percent) {
+            return std::unique_ptr<EffectStage>(new ResizeStage(percent < 0 ? 50 : percent));
+        });
+    }
+
+    // Кадров, запрошенных у одного Capturer'а наперед (в пакетном режиме - не меньше пакета: иначе очереди нет).
+    // Без пакетов - только worker_capturer_credit: лишние кадры ждали бы здесь, а не у других Worker'ов
+    int capturer_credit() const {
+        return std::max(1, batch_enabled() ? std::max(worker_capturer_credit, worker_batch_max) : worker_capturer_credit);
     }
 
-    // Создание protobuf сообщения с изображением
-    video_processing::ImageData create_image_data(const cv::Mat& image) {
-        video_processing::ImageData image_data;  // Создаем объект для данных изображения
+    // Цепочка из одного эффекта scanner_darkly: быстрые уровни, инкрементальный режим, пакеты и ступени
+    // регулятора задержки работают с ScannerDarklyEffect и для других этапов не применяются
+    bool scanner_darkly_only() const {
+        return effect_chain.isSingle("scanner_darkly");
+    }
 
-        // Кодируем изображение в JPEG
-        std::vector<uchar> buffer;  // Буфер для сжатых данных
-        std::vector<int> compression_params = { cv::IMWRITE_JPEG_QUALITY, cap_quality };  // Параметры сжатия (качество 80%)
-        cv::imencode(".jpg", image, buffer, compression_params);  // Кодируем в JPEG
+    // Инкрементальный режим: только для scanner_darkly (плитки вклеиваются в результат эффекта Worker'а)
+    bool incremental_enabled() const {
+        return effect_incremental && scanner_darkly_only();
+    }
 
-        // Заполняем поля protobuf сообщения
-        image_data.set_width(image.cols);        // Ширина изображения
-        image_data.set_height(image.rows);       // Высота изображения
-        image_data.set_pixel_format(proto_pixel_format);  // Формат пикселей BGR
-        image_data.set_encoding(proto_image_encoding);     // Кодирование JPEG
-        image_data.set_image_data(buffer.data(), buffer.size());  // Данные изображения
+    // Пакетный режим: только полный уровень и цепочка из одного эффекта scanner_darkly
+    // (быстрый уровень, инкрементальный режим и другие этапы обучают палитру сами)
+    bool batch_enabled() const {
+        return worker_batch_max > 1 && processing_tier == 0 && !effect_incremental && scanner_darkly_only();
+    }
 
-        return image_data;  // Возвращаем заполненный объект
+    // Вариант настроек для кэша результатов: формат пикселей, масштаб и ступень регулятора
+    uint64_t cache_variant_for(video_processing::PixelFormat pixel_format, int scale) const {
+        return (static_cast<uint64_t>(pixel_format) << 16) | (static_cast<uint64_t>(scale) << 8)
+            | static_cast<uint64_t>(latency.tier());
+    }
+
+    // Извлечение изображения из protobuf сообщения (scale > 1 - уменьшенное в scale раз для быстрого уровня).
+    // Любые pixel_format и encoding: BGR/RGB - кадр BGR, GRAY - одноканальный кадр (эффект работает в сером)
+    cv::Mat extract_image(const video_processing::ImageData& image_data, int scale = 1) {
+        cv::Mat image;
+        if (!frame_messages::decodeImageData(image_data, scale, false, image)) {  // RAW - без копии байтов до resize / clone
+            throw std::runtime_error("- [FAIL] Failed to decode image (encoding " + std::to_string(image_data.encoding())
+                + ", pixel format " + std::to_string(image_data.pixel_format()) + ")");
+        }
+        return image;
+    }
+
+    // Обработанный кадр в pixel_format входного кадра: кодирование worker_processed_encoding
+    // (PALETTE_RLE при числе цветов больше 255 заменяется на JPEG)
+    void fill_processed_data(const cv::Mat& image, video_processing::PixelFormat pixel_format,
+        video_processing::ImageData* image_data) {
+        frame_messages::encodeImageData(image, compression_params, pixel_format, worker_processed_encoding,
+            encode_buffers, image_data);
     }
 
     // Вывод статистики работы
@@ -149,18 +299,254 @@ private:
             << processed_count << " processed, "    // Обработано кадров
             << failed_count << " failed "          // Неудачных обработок
             << std::fixed << std::setprecision(1) <<  "" << std::endl;  // FPS с одним знаком после запятой
+        if (incremental_enabled() && processed_count > 0) {
+            std::cout << "=== Worker " << worker_id << " average tiles recomputed: "
+                << recomputed_tiles_sum * 100.0 / processed_count << "%" << std::endl;  // Средняя доля пересчитанных плиток
+        }
+        if (processed_count > 0) {
+            std::cout << "=== Worker " << worker_id << " effect: " << std::setprecision(2)
+                << effect_ms_sum / processed_count << " ms avg, latency tier " << latency.tier()
+                << (latency.enabled() && scanner_darkly_only() ? "" : " (regulator off)") << std::endl;
+        }
+        std::cout << std::setprecision(2);
+        effect_chain.printStats(std::cout, "=== Worker " + worker_id + " stage ");  // Среднее время этапов цепочки
+        if (batch_count > 0) {
+            std::cout << "=== Worker " << worker_id << " batches: " << batch_count << ", " << std::setprecision(1)
+                << static_cast<double>(batch_frames) / batch_count << " frames avg" << std::endl;  // Размер пакета по глубине очереди
+        }
+        if (outbox.queued() > 0 || !outbox.empty()) {
+            std::cout << "=== Worker " << worker_id << " outbox: depth " << outbox.size() << "/" << outbox.capacity()
+                << ", max " << outbox.maxDepth() << ", queued " << outbox.queued() << ", dropped " << outbox.dropped()
+                << ", requests withheld " << requests_withheld << " times" << std::endl;  // Composer не успевал принимать
+        }
+        if (result_cache.enabled()) {
+            std::cout << std::setprecision(1);
+            result_cache.printStats(std::cout, "=== Worker " + worker_id + " cache: ");  // Попадания и промахи кэша
+        }
+        placement.printStats(std::cout, "=== Worker " + worker_id + " placement: ",  // Работа вне своего узла NUMA
+            processed_image.data, processed_image.total() * processed_image.elemSize());
+        if (capturers.size() > 1) {
+            for (const auto& link : capturers) {  // Доля кадров каждого Capturer'а
+                std::cout << "=== Worker " << worker_id << " capturer " << link.address << ": "
+                    << link.received << " frames" << std::endl;
+            }
+        }
+    }
+
+    // Отправка обработанного кадра (processed_image): оригинал как есть, в его формате и кодировании
+    // (обмен вместо повторного кодирования и копии), обработанный - в pixel_format входа. Результат - в кэш
+    void send_processed_result(video_processing::VideoFrame& input_frame, int frame_latency_tier,
+        video_processing::PixelFormat pixel_format, uint64_t cache_key, uint64_t cache_variant, uint64_t cache_phash) {
+        // Заполняем сообщение для Composer (переиспользуемое)
+        fill_output_header(input_frame, frame_latency_tier);
+
+        // Добавляем оба изображения (оригинал и обработанное)
+        auto* image_pair = output_frame.mutable_image_pair();  // Получаем указатель на пару изображений
+        image_pair->mutable_original()->Swap(input_frame.mutable_single_image());
+        fill_processed_data(processed_image, pixel_format, image_pair->mutable_processed());  // Добавляем обработанное
+        if (result_cache.enabled()) {
+            ResultCache::Result result;  // Закодированный результат - для повторов этого входа
+            result.data = image_pair->processed().image_data();
+            result.width = processed_image.cols;
+            result.height = processed_image.rows;
+            result.encoding = image_pair->processed().encoding();
+            result.pixel_format = pixel_format;
+            result_cache.insert(cache_key, cache_variant, cache_phash, std::move(result));
+        }
+
+        // Отправляем результат в Composer
+        if (send_to_composer(output_frame)) {  // Если отправка успешна
+            processed_count++;  // Увеличиваем счетчик обработанных
+            std::cout << "- [ OK ] " << worker_id << " sent to Composer: " << output_frame.frame_id() << std::endl;
+        }
+        else {  // Если отправка не удалась
+            failed_count++;  // Увеличиваем счетчик ошибок
+            std::cout << "- [FAIL] " << worker_id << " failed to send: " << output_frame.frame_id() << std::endl;
+        }
+
+        // Показываем статистику каждые 50 кадров
+        if (processed_count % 50 == 0) {
+            show_statistics();  // Вывод статистики
+        }
     }
 
-    // Отправка результата в Composer
-    bool send_to_composer(const video_processing::VideoFrame& output_frame) {
+    // Пакет: первый кадр и кадры, уже пришедшие от Capturer'ов (без ожидания), не больше worker_batch_max.
+    // Размер пакета следует за глубиной очереди: при пустой очереди пакет из одного кадра без задержки.
+    // Кадры группируются по потоку (sender_id и формат пикселей), у каждой группы - своя общая палитра
+    void process_batch(video_processing::VideoFrame& first_frame) {
+        const size_t limit = static_cast<size_t>(worker_batch_max);
+        if (batch.size() < limit) {
+            batch.resize(limit);
+        }
+        batch[0].frame.Swap(&first_frame);
+        size_t count = 1;
+        zmq::message_t message;
+        while (count < limit && receive_frame(message, 0)) {
+            video_processing::VideoFrame& frame = batch[count].frame;
+            if (!frame.ParseFromArray(message.data(), static_cast<int>(message.size())) || !frame.has_single_image()) {
+                std::cout << "- [FAIL] Failed to parse message from Capturer" << std::endl;
+                failed_count++;
+                continue;
+            }
+            count++;
+        }
+        batch_count++;
+        batch_frames += count;
+        if (count > 1) {
+            std::cout << "- [ OK ] " << worker_id << " batch of " << count << " frames" << std::endl;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            batch[i].grouped = false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (batch[i].grouped) {
+                continue;
+            }
+            const auto& first = batch[i].frame;
+            batch_group.clear();
+            for (size_t j = i; j < count; j++) {  // Порядок кадров внутри потока сохраняется
+                const auto& frame = batch[j].frame;
+                if (!batch[j].grouped && frame.sender_id() == first.sender_id()
+                    && frame.single_image().pixel_format() == first.single_image().pixel_format()) {
+                    batch[j].grouped = true;
+                    batch_group.push_back(j);
+                }
+            }
+            process_batch_group();
+        }
+    }
+
+    // Группа кадров одного потока: кэш, декодирование, одно обучение палитры на объединенной подвыборке,
+    // затем назначение цветов и отправка каждого кадра. Время обучения делится поровну между кадрами
+    void process_batch_group() {
+        const auto pixel_format = batch[batch_group[0]].frame.single_image().pixel_format();
+        const uint64_t cache_variant = cache_variant_for(pixel_format, 1);
+        const int frame_latency_tier = latency.tier();
+        batch_images.clear();
+        for (size_t index : batch_group) {
+            BatchItem& item = batch[index];
+            item.image.release();
+            std::cout << "- [ OK ] " << worker_id << " processing frame: " << item.frame.frame_id()
+                << " from " << item.frame.sender_id() << std::endl;
+            item.cache_key = 0;
+            item.cache_phash = 0;
+            if (result_cache.enabled()) {
+                const std::string& input_bytes = item.frame.single_image().image_data();
+                item.cache_key = ResultCache::hashBytes(input_bytes.data(), input_bytes.size(), cache_variant);
+                const ResultCache::Result* cached = result_cache.find(item.cache_key, cache_variant, input_bytes, item.cache_phash);
+                if (cached) {
+                    send_cached_result(item.frame, *cached);
+                    continue;
+                }
+            }
+            try {
+                item.image = extract_image(item.frame.single_image());
+            }
+            catch (const std::exception& e) {
+                std::cout << "- [FAIL] Failed to extract image: " << e.what() << std::endl;
+                failed_count++;
+                continue;
+            }
+            batch_images.push_back(item.image);  // Заголовок cv::Mat без копии пикселей
+        }
+        if (batch_images.empty()) {
+            return;
+        }
+
+        auto train_start = std::chrono::steady_clock::now();
         try {
-            std::string serialized = output_frame.SerializeAsString();  // Сериализуем protobuf сообщение
-            zmq::message_t output_message(serialized.size());  // Создаем ZeroMQ сообщение
-            memcpy(output_message.data(), serialized.data(), serialized.size());  // Копируем данные
+            effect.trainSharedPalette(batch_images);
+        }
+        catch (const std::exception& e) {
+            std::cout << "- [FAIL] Failed to train batch palette: " << e.what() << std::endl;
+            failed_count += batch_images.size();
+            return;
+        }
+        const double train_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - train_start).count() / batch_images.size();
 
-            // Отправляем сообщение без блокировки
-            bool sent = push_socket.send(output_message, ZMQ_DONTWAIT);
-            return sent;  // Возвращаем результат отправки
+        for (size_t index : batch_group) {
+            BatchItem& item = batch[index];
+            if (item.image.empty()) {
+                continue;  // Отправлен из кэша или не декодирован
+            }
+            auto effect_start = std::chrono::steady_clock::now();
+            try {
+                effect.applyEffectWithPalette(item.image, processed_image);
+            }
+            catch (const std::exception& e) {
+                std::cout << "- [FAIL] Failed to apply effect: " << e.what() << std::endl;
+                failed_count++;
+                continue;
+            }
+            const double effect_ms = train_ms + std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - effect_start).count();
+            effect_ms_sum += effect_ms;
+            placement.sample();
+            if (latency.update(effect_ms)) {  // Пакеты - только для scanner_darkly
+                apply_latency_tier();  // Новые настройки - со следующего пакета
+            }
+            send_processed_result(item.frame, frame_latency_tier, pixel_format, item.cache_key, cache_variant, item.cache_phash);
+        }
+    }
+
+    // Заголовок результата для Composer'а (общий для обработанного и взятого из кэша кадра).
+    // Сообщение переиспользуется, поэтому заполняются все поля заголовка
+    void fill_output_header(const video_processing::VideoFrame& input_frame, int frame_latency_tier) {
+        output_frame.set_frame_id(input_frame.frame_id());  // Сохраняем ID кадра
+        output_frame.set_timestamp(input_frame.timestamp());  // Сохраняем временную метку
+        output_frame.set_sender_id(worker_id);  // Устанавливаем ID отправителя
+        output_frame.set_frame_type(video_processing::PROCESSED_FRAME);  // Тип: обработанный кадр
+        output_frame.set_latency_tier(frame_latency_tier);  // Ступень регулятора задержки
+        output_frame.set_source_id(input_frame.sender_id());  // Источник кадра - Capturer (нумерация кадров своя у каждого)
+    }
+
+    // Отправка результата из кэша: оригинал - входной кадр как есть (забирается обменом), обработанный - сохраненные байты
+    void send_cached_result(video_processing::VideoFrame& input_frame, const ResultCache::Result& cached) {
+        fill_output_header(input_frame, latency.tier());
+        auto* image_pair = output_frame.mutable_image_pair();
+        image_pair->mutable_original()->Swap(input_frame.mutable_single_image());
+        auto* processed = image_pair->mutable_processed();
+        processed->set_width(cached.width);
+        processed->set_height(cached.height);
+        processed->set_pixel_format(static_cast<video_processing::PixelFormat>(cached.pixel_format));
+        processed->set_encoding(static_cast<video_processing::ImageEncoding>(cached.encoding));
+        processed->mutable_image_data()->assign(cached.data);
+        if (send_to_composer(output_frame)) {
+            processed_count++;
+            std::cout << "- [ OK ] " << worker_id << " sent cached result to Composer: " << output_frame.frame_id() << std::endl;
+        }
+        else {
+            failed_count++;
+            std::cout << "- [FAIL] " << worker_id << " failed to send: " << output_frame.frame_id() << std::endl;
+        }
+        if (processed_count % 50 == 0) {
+            show_statistics();
+        }
+    }
+
+    // Отправка результата в Composer. Если очередь PUSH заполнена (Composer временно не успевает), результат
+    // ждет в outbox и уходит по POLLOUT из основного цикла - готовый кадр не теряется. false - ошибка или полный outbox
+    bool send_to_composer(const video_processing::VideoFrame& frame) {
+        try {
+            // Сериализуем protobuf сообщение сразу в буфер ZeroMQ (без промежуточной строки и memcpy)
+            zmq::message_t output_message(frame.ByteSizeLong());
+            frame.SerializeToArray(output_message.data(), static_cast<int>(output_message.size()));
+
+            // Сначала более ранние результаты (порядок кадров сохраняется), затем новый - без блокировки
+            const ResultOutbox::SendResult result = outbox.send(push_socket, output_message);
+            arm_pollout();  // Результат остался в outbox - отправим по POLLOUT
+            if (result == ResultOutbox::SendResult::Dropped) {
+                std::cout << "- [FAIL] " << worker_id << " outbox full (" << outbox.size() << "), dropping frame: "
+                    << frame.frame_id() << std::endl;
+                return false;
+            }
+            if (result == ResultOutbox::SendResult::Queued) {
+                std::cout << "- [ -- ] " << worker_id << " Composer busy, frame " << frame.frame_id()
+                    << " queued in outbox (" << outbox.size() << "/" << outbox.capacity() << ")" << std::endl;
+            }
+            return true;
         }
         catch (const std::exception& e) {  // Обработка ошибок
             std::cout << "- [FAIL] Error sending to Composer: " << e.what() << std::endl;
@@ -168,21 +554,157 @@ private:
         }
     }
 
-    // Запрос нового кадра у Capturer'а
-    void request_frame() {
+    // Отправка результатов из outbox, пока PUSH сокет их принимает. Освободившееся место возобновляет
+    // отложенные запросы кадров
+    void flush_outbox() {
         try {
-            // Отправляем запрос на получение кадра
-            zmq::message_t request(3);  // Создаем сообщение размером 3 байта
-            memcpy(request.data(), "GET", 3);  // Копируем строку "GET"
-            dealer_socket.send(request, ZMQ_DONTWAIT);  // Отправляем без блокировки
-        }
-        catch (const zmq::error_t& e) {  // Обработка ошибок ZeroMQ
-            if (e.num() != EAGAIN) {  // Игнорируем ошибку "resource temporarily unavailable"
-                std::cout << "- [FAIL] Error requesting frame: " << e.what() << std::endl;
+            outbox.flush(push_socket);
+        }
+        catch (const zmq::error_t& e) {
+            std::cout << "- [FAIL] Error sending to Composer: " << e.what() << std::endl;
+        }
+        arm_pollout();
+        if (requests_paused && !outbox.full()) {
+            requests_paused = false;
+            request_frame();
+        }
+    }
+
+    // POLLOUT на PUSH сокете - пока outbox не пуст: иначе результат в outbox не уйдет, а запросы кадров не возобновятся
+    void arm_pollout() {
+        poll_items.back().events = outbox.pollEvents();
+    }
+
+    // Запрос новых кадров: каждому Capturer'у - до worker_capturer_credit ожидаемых кадров
+    void request_frame() {
+        if (draining) {
+            return;  // При drain новые кадры не запрашиваются
+        }
+        if (outbox.full()) {
+            // Обратное давление: новых кадров не берем, пока Composer не примет готовые
+            if (!requests_paused) {
+                requests_paused = true;
+                requests_withheld++;
+            }
+            return;
+        }
+        for (auto& link : capturers) {
+            while (link.outstanding < capturer_credit()) {
+                try {
+                    // Отправляем запрос на получение кадра
+                    zmq::message_t request(3);  // Создаем сообщение размером 3 байта
+                    memcpy(request.data(), "GET", 3);  // Копируем строку "GET"
+                    if (!link.socket->send(request, ZMQ_DONTWAIT)) {  // Отправляем без блокировки
+                        break;  // Очередь сокета заполнена - повторим после следующего кадра
+                    }
+                    link.outstanding++;
+                }
+                catch (const zmq::error_t& e) {  // Обработка ошибок ZeroMQ
+                    if (e.num() != EAGAIN) {  // Игнорируем ошибку "resource temporarily unavailable"
+                        std::cout << "- [FAIL] Error requesting frame: " << e.what() << std::endl;
+                    }
+                    break;
+                }
             }
         }
     }
 
+    // Прием кадра от одного из Capturer'ов: опрос начинается со следующего после последнего обслуженного,
+    // поэтому при очереди у нескольких Capturer'ов кадры берутся по очереди. nullptr - кадров нет
+    // Заодно по POLLOUT отправляются результаты из outbox
+    CapturerLink* receive_frame(zmq::message_t& message, long timeout_ms) {
+        if (zmq::poll(poll_items, timeout_ms) <= 0) {
+            return nullptr;
+        }
+        if (poll_items.back().revents & ZMQ_POLLOUT) {
+            flush_outbox();
+        }
+        for (size_t i = 0; i < capturers.size(); i++) {
+            const size_t index = (next_capturer + i) % capturers.size();
+            if (!(poll_items[index].revents & ZMQ_POLLIN)) {
+                continue;
+            }
+            CapturerLink& link = capturers[index];
+            if (link.socket->recv(&message, ZMQ_DONTWAIT)) {
+                if (message.size() == 3 && memcmp(message.data(), "BYE", 3) == 0) {
+                    link.drained = true;  // Подтверждение drain: все кадры этого Capturer'а уже получены
+                    link.outstanding = 0;
+                    if (!link.stream_id.empty()) {
+                        incremental.resetStream(link.stream_id);  // Состояние потока больше не понадобится
+                    }
+                    std::cout << "- [ OK ] " << worker_id << " released by Capturer: " << link.address << std::endl;
+                    continue;
+                }
+                link.outstanding = std::max(0, link.outstanding - 1);
+                link.received++;
+                next_capturer = (index + 1) % capturers.size();
+                return &link;
+            }
+        }
+        return nullptr;
+    }
+
+    // Начало drain: Capturer'ам уходит "BYE", они снимают запросы Worker'а и подтверждают уход
+    void begin_drain() {
+        draining = true;
+        drain_start = std::chrono::steady_clock::now();
+        std::cout << "=== Worker " << worker_id << " draining: finishing in-flight frames ===" << std::endl;
+        for (auto& link : capturers) {
+            try {
+                zmq::message_t bye(3);
+                memcpy(bye.data(), "BYE", 3);
+                link.socket->send(bye, ZMQ_DONTWAIT);  // Не отправлено - дождемся worker_drain_timeout_ms
+            }
+            catch (const zmq::error_t& e) {
+                std::cout << "- [FAIL] Error sending BYE to " << link.address << ": " << e.what() << std::endl;
+            }
+        }
+    }
+
+    // Drain закончен: все Capturer'ы подтвердили уход или истек worker_drain_timeout_ms
+    bool drain_complete() {
+        bool all_released = true;
+        for (const auto& link : capturers) {
+            all_released = all_released && link.drained;
+        }
+        if (all_released) {
+            return true;
+        }
+        auto elapsed = std::chrono::steady_clock::now() - drain_start;
+        if (elapsed > std::chrono::milliseconds(worker_drain_timeout_ms)) {
+            std::cout << "- [FAIL] " << worker_id << " drain timeout: not all capturers acknowledged" << std::endl;
+            return true;
+        }
+        return false;
+    }
+
+    // Отправка очереди PUSH в Composer перед выходом: закрытие контекста ждет отправки до worker_drain_timeout_ms
+    void flush_results() {
+        // Результаты из outbox - в очередь сокета (ожидание места не больше worker_drain_timeout_ms)
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(0, worker_drain_timeout_ms));
+        while (!outbox.empty() && std::chrono::steady_clock::now() < deadline) {
+            zmq::pollitem_t item = { static_cast<void*>(push_socket), 0, ZMQ_POLLOUT, 0 };
+            zmq::poll(&item, 1, 10);
+            flush_outbox();
+        }
+        if (!outbox.empty()) {
+            const size_t left = outbox.clear();
+            failed_count += left;
+            std::cout << "- [FAIL] " << worker_id << " " << left << " results left in outbox" << std::endl;
+        }
+
+        int no_linger = 0;  // Неотправленные запросы к Capturer'ам не нужны
+        for (auto& link : capturers) {
+            link.socket->setsockopt(ZMQ_LINGER, &no_linger, sizeof(no_linger));
+            link.socket->close();
+        }
+        int linger = std::max(0, worker_drain_timeout_ms);
+        push_socket.setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+        push_socket.close();
+        context.close();  // Блокирует, пока результаты не уйдут в Composer (или не истечет linger)
+        std::cout << "- [ OK ] " << worker_id << " results flushed to Composer" << std::endl;
+    }
+
 public:
     // Основной цикл работы Worker'а
     void run() {
@@ -190,20 +712,31 @@ public:
         std::cout << "=== Worker Started ===" << std::endl;
         std::cout << std::endl << "=== 3-ROUTER-DEALER with frame skips ===" << std::endl << std::endl;
         std::cout << "DEALER pattern: Request-based load balancing. Request frames when ready" << std::endl;
-        std::cout << "4. Listening from: " << capturer_address << std::endl;  // Адрес источника
+        for (const auto& link : capturers) {
+            std::cout << "4. Listening from: " << link.address << std::endl;  // Адрес источника
+        }
+        if (capturers.size() > 1) {
+            std::cout << "   Fan-in: " << capturers.size() << " capturers, credit " << capturer_credit() << " each" << std::endl;
+        }
         std::cout << "5. Sending to: " << composer_address << std::endl;      // Адрес назначения
 
 
-        // Запрашиваем первый кадр
+        // Запрашиваем первые кадры у всех Capturer'ов
         request_frame();
 
         // Основной цикл обработки
         while (!stop_requested) {  // Пока не запрошена остановка
+            if (g_drain_requested && !draining) {
+                begin_drain();  // Ctrl+C / закрытие окна: доработать полученные кадры и уйти
+            }
+            if (draining && drain_complete()) {
+                break;
+            }
             try {
                 zmq::message_t message;  // Сообщение для приема данных
 
-                // Проверяем есть ли кадр от Capturer (без блокировки)
-                if (dealer_socket.recv(&message, ZMQ_DONTWAIT)) {
+                // Проверяем есть ли кадр от Capturer'ов (ожидание не больше 1 мс)
+                if (CapturerLink* link = receive_frame(message, 1)) {
                     // Десериализуем сообщение от Capturer
                     video_processing::VideoFrame input_frame;
                     if (!input_frame.ParseFromArray(message.data(), message.size())) {  // Парсим protobuf
@@ -213,15 +746,43 @@ public:
                         request_frame();
                         continue;  // Переходим к следующей итерации
                     }
+                    link->stream_id = input_frame.sender_id();
+
+                    // Пакетный режим: вместе с кадрами, уже ожидающими в сокетах, и общей палитрой
+                    if (batch_enabled() && input_frame.has_single_image()) {
+                        process_batch(input_frame);
+                        request_frame();  // Запрашиваем следующие кадры
+                        continue;
+                    }
 
                     // Вывод информации о полученном кадре
-                    std::cout << "- [ OK ] " << worker_id << " processing frame: " << input_frame.frame_id() << std::endl;
+                    std::cout << "- [ OK ] " << worker_id << " processing frame: " << input_frame.frame_id()
+                        << " from " << input_frame.sender_id() << std::endl;
 
                     // Извлекаем исходное изображение
                     if (input_frame.has_single_image()) {  // Проверяем наличие изображения
                         cv::Mat original_image;  // Переменная для исходного изображения
+                        const int scale = 1 << processing_tier;  // Уровень фиксируется на весь кадр
+
+                        // Кэш: тот же (или похожий по dHash) входной кадр при тех же настройках - готовый результат
+                        // без декодирования, эффекта и кодирования
+                        const video_processing::PixelFormat pixel_format = input_frame.single_image().pixel_format();  // Формат результата
+                        const uint64_t cache_variant = cache_variant_for(pixel_format, scale);
+                        uint64_t cache_key = 0;
+                        uint64_t cache_phash = 0;
+                        if (result_cache.enabled()) {
+                            const std::string& input_bytes = input_frame.single_image().image_data();
+                            cache_key = ResultCache::hashBytes(input_bytes.data(), input_bytes.size(), cache_variant);
+                            const ResultCache::Result* cached = result_cache.find(cache_key, cache_variant, input_bytes, cache_phash);
+                            if (cached) {
+                                send_cached_result(input_frame, *cached);
+                                request_frame();  // Запрашиваем следующий кадр
+                                continue;
+                            }
+                        }
+
                         try {
-                            original_image = extract_image(input_frame.single_image());  // Извлекаем изображение
+                            original_image = extract_image(input_frame.single_image(), scale);  // Извлекаем изображение
                         }
                         catch (const std::exception& e) {  // Обработка ошибок извлечения
                             std::cout << "- [FAIL] Failed to extract image: " << e.what() << std::endl;
@@ -233,9 +794,28 @@ public:
                         // Проверяем что изображение не пустое
                         if (!original_image.empty()) {
                             // Применяем эффект Scanner Darkly
-                            cv::Mat processed_image;  // Переменная для обработанного изображения
+                            const int frame_latency_tier = latency.tier();  // Ступень, с которой обработан кадр
+                            auto effect_start = std::chrono::steady_clock::now();
                             try {
-                                processed_image = effect.applyEffect(original_image);  // Применяем эффект
+                                if (scale > 1) {
+                                    // Быстрый уровень: эффект по уменьшенному кадру, результат - в исходном размере
+                                    const auto& source = input_frame.single_image();
+                                    cv::Size full_size(static_cast<int>(source.width()), static_cast<int>(source.height()));
+                                    if (full_size.area() == 0) {
+                                        full_size = cv::Size(original_image.cols * scale, original_image.rows * scale);
+                                    }
+                                    effect.applyEffectUpscaled(original_image, scale, full_size, processed_image);
+                                }
+                                else if (incremental_enabled() && original_image.channels() == 3) {  // Плитки и палитра потока - только BGR
+                                    // Только измененные плитки, остальное - из предыдущего результата потока
+                                    double recomputed = incremental.apply(input_frame.sender_id(), original_image, processed_image);
+                                    recomputed_tiles_sum += recomputed;
+                                    std::cout << "- [ OK ] " << worker_id << " tiles recomputed: " << std::fixed << std::setprecision(1)
+                                        << recomputed * 100.0 << "%" << std::endl;
+                                }
+                                else {
+                                    effect_chain.process(original_image, processed_image);  // Цепочка эффектов в буфер Worker'а
+                                }
                             }
                             catch (const std::exception& e) {  // Обработка ошибок эффекта
                                 std::cout << "- [FAIL] Failed to apply effect: " << e.what() << std::endl;
@@ -243,33 +823,17 @@ public:
                                 request_frame();  // Запрашиваем следующий кадр
                                 continue;  // Переходим к следующей итерации
                             }
-
-                            // Создаем сообщение для Composer
-                            video_processing::VideoFrame output_frame;
-                            output_frame.set_frame_id(input_frame.frame_id());  // Сохраняем ID кадра
-                            output_frame.set_timestamp(input_frame.timestamp());  // Сохраняем временную метку
-                            output_frame.set_sender_id(worker_id);  // Устанавливаем ID отправителя
-                            output_frame.set_frame_type(video_processing::PROCESSED_FRAME);  // Тип: обработанный кадр
-
-                            // Добавляем оба изображения (оригинал и обработанное)
-                            auto* image_pair = output_frame.mutable_image_pair();  // Получаем указатель на пару изображений
-                            *image_pair->mutable_original() = create_image_data(original_image);  // Добавляем оригинал
-                            *image_pair->mutable_processed() = create_image_data(processed_image);  // Добавляем обработанное
-
-                            // Отправляем результат в Composer
-                            if (send_to_composer(output_frame)) {  // Если отправка успешна
-                                processed_count++;  // Увеличиваем счетчик обработанных
-                                std::cout << "- [ OK ] " << worker_id << " sent to Composer: " << output_frame.frame_id() << std::endl;
-                            }
-                            else {  // Если отправка не удалась
-                                failed_count++;  // Увеличиваем счетчик ошибок
-                                std::cout << "- [FAIL] " << worker_id << " failed to send: " << output_frame.frame_id() << std::endl;
+                            double effect_ms = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - effect_start).count();
+                            effect_ms_sum += effect_ms;
+                            placement.sample();  // Узел NUMA, на котором обработан кадр
+                            if (scanner_darkly_only() && latency.update(effect_ms)) {  // Ступени меняют настройки ScannerDarklyEffect
+                                apply_latency_tier();  // Новые настройки - со следующего кадра
                             }
 
-                            // Показываем статистику каждые 50 кадров
-                            if (processed_count % 50 == 0) {
-                                show_statistics();  // Вывод статистики
-                            }
+                            // Сообщение для Composer, кэш и отправка
+                            send_processed_result(input_frame, frame_latency_tier, pixel_format,
+                                cache_key, cache_variant, cache_phash);
                         }
                         else {  // Если изображение пустое
                             failed_count++;  // Увеличиваем счетчик ошибок
@@ -284,10 +848,7 @@ public:
                     // Запрашиваем следующий кадр сразу после обработки
                     request_frame();
                 }
-                else {  // Если нет сообщений от Capturer'а
-                    // Нет сообщений, небольшая пауза чтобы не нагружать CPU
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                }
+                // Если нет сообщений от Capturer'ов - receive_frame уже подождал до 1 мс, CPU не нагружается
             }
             catch (const zmq::error_t& e) {  // Обработка ошибок ZeroMQ
                 if (e.num() != EAGAIN && e.num() != EINTR) {  // Игнорируем временные ошибки и прерывания
@@ -305,13 +866,50 @@ public:
             }
         }
 
+        flush_results();
+        show_statistics();
+        g_drain_finished = true;
     }
 };
 
+// Обработчик консоли: Ctrl+C, Ctrl+Break и закрытие окна запускают drain вместо немедленного завершения
+BOOL WINAPI console_control_handler(DWORD control_type) {
+    switch (control_type) {
+    case CTRL_C_EVENT:
+    case CTRL_BREAK_EVENT:
+        g_drain_requested = true;
+        return TRUE;  // Процесс не завершается: Worker выйдет сам после drain
+    case CTRL_CLOSE_EVENT:
+    case CTRL_LOGOFF_EVENT:
+    case CTRL_SHUTDOWN_EVENT: {
+        // После возврата из обработчика процесс будет завершен - ждем окончания drain
+        g_drain_requested = true;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(worker_drain_timeout_ms + 1000);
+        while (!g_drain_finished && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return TRUE;
+    }
+    default:
+        return FALSE;
+    }
+}
+
 // Главная функция программы
 int main() {
     try {
-        Worker worker;  // Создаем экземпляр Worker'а
+        SetConsoleCtrlHandler(console_control_handler, TRUE);  // Drain по Ctrl+C и закрытию окна
+
+        // Закрепление на ядрах до создания Worker'а: буферы и поток ZeroMQ - уже на выбранном узле
+        CpuPlacement placement;
+        std::string placement_error;
+        if (!placement.apply(worker_cpu_affinity, worker_numa_node, worker_cores_per_worker, placement_error)) {
+            std::cout << "- [FAIL] CPU placement: " << placement_error << ", running unpinned" << std::endl;
+        }
+        else if (placement.active()) {
+            cv::setNumThreads(placement.coreCount());  // Один поток OpenCV на физическое ядро
+        }
+        Worker worker(placement);  // Создаем экземпляр Worker'а
         worker.run();  // Запускаем основной цикл
         return 0;  // Успешное завершение
     }
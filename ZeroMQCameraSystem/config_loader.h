@@ -104,6 +104,8 @@ public:
             if (value == "JPEG") return video_processing::JPEG;
             if (value == "PNG") return video_processing::PNG;
             if (value == "RAW") return video_processing::RAW;
+            if (value == "BMP") return video_processing::BMP;
+            if (value == "PALETTE_RLE") return video_processing::PALETTE_RLE;
 
             std::cout << "- [WARN] Unknown image encoding: " << value << ", using default" << std::endl;
         }
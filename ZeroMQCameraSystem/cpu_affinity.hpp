@@ -0,0 +1,278 @@
+﻿#pragma once
+#ifndef NOMINMAX
+#define NOMINMAX  // std::min / std::max вместо макросов windows.h
+#endif
+#ifndef PSAPI_VERSION
+#define PSAPI_VERSION 2  // QueryWorkingSetEx -> K32QueryWorkingSetEx из kernel32 (без psapi.lib)
+#endif
+#include <windows.h>
+#include <psapi.h>
+// Группы процессоров и NUMA (GetLogicalProcessorInformationEx, SetThreadGroupAffinity и др.) - с Windows 7.
+// zmq.h, включенный раньше, задает _WIN32_WINNT 0x0600 и скрывает эти объявления: версия задается в проекте
+#if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0601
+#error "cpu_affinity.hpp requires _WIN32_WINNT >= 0x0601 (set in the project PreprocessorDefinitions)"
+#endif
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+
+// Размещение Worker'а на ядрах: процесс (поток ввода-вывода ZeroMQ и потоки OpenCV) ограничивается
+// выбранными физическими ядрами, поток обработки закрепляется на первом из них. Размещение делается
+// до создания Worker'а, поэтому буферы эффекта выделяются закрепленным потоком на его узле NUMA
+class CpuPlacement {
+public:
+	// Физическое ядро: логические процессоры (hyper-threading) одной группы и узел NUMA
+	struct Core {
+		WORD group;
+		KAFFINITY mask;
+		int node;
+	};
+
+private:
+	std::vector<Core> cores_;  // Все физические ядра, по узлам NUMA
+	std::vector<Core> chosen_;  // Ядра Worker'а (пусто - размещение выключено)
+	int node_ = -1;  // Узел NUMA выбранных ядер (-1 - ядра на разных узлах)
+	int slot_ = -1;  // Номер места при автоматическом размещении
+	HANDLE slot_mutex_ = nullptr;  // Именованный mutex занятого места: освобождается при завершении процесса
+	uint64_t samples_ = 0;  // Замеров узла потока обработки
+	uint64_t remote_samples_ = 0;  // Замеров, когда поток выполнялся на чужом узле
+
+	static int lowestProcessor(KAFFINITY mask) {
+		int index = 0;
+		while (mask && !(mask & 1)) {
+			mask >>= 1;
+			index++;
+		}
+		return index;
+	}
+
+	static std::vector<Core> enumerateCores() {
+		std::vector<Core> cores;
+		DWORD length = 0;
+		GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length);
+		std::vector<char> buffer(length);
+		if (length == 0 || !GetLogicalProcessorInformationEx(RelationProcessorCore,
+			reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data()), &length)) {
+			return cores;
+		}
+		for (DWORD offset = 0; offset < length;) {
+			const auto* info = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+			const GROUP_AFFINITY& group_mask = info->Processor.GroupMask[0];
+			PROCESSOR_NUMBER first = {};
+			first.Group = group_mask.Group;
+			first.Number = static_cast<BYTE>(lowestProcessor(group_mask.Mask));
+			USHORT node = 0;
+			GetNumaProcessorNodeEx(&first, &node);
+			cores.push_back({ group_mask.Group, group_mask.Mask, static_cast<int>(node) });
+			offset += info->Size;
+		}
+		std::stable_sort(cores.begin(), cores.end(), [](const Core& a, const Core& b) { return a.node < b.node; });
+		return cores;
+	}
+
+	// Первое свободное место среди slots: Worker'ы на одной машине получают разные ядра без общего конфига
+	int claimSlot(int slots) {
+		for (int i = 0; i < slots; i++) {
+			const std::string name = "Local\\ZeroMQCameraSystem_worker_slot_" + std::to_string(i);
+			HANDLE mutex = CreateMutexA(nullptr, FALSE, name.c_str());
+			if (!mutex) {
+				continue;
+			}
+			if (GetLastError() == ERROR_ALREADY_EXISTS) {
+				CloseHandle(mutex);
+				continue;
+			}
+			slot_mutex_ = mutex;
+			return i;
+		}
+		return -1;
+	}
+
+public:
+	CpuPlacement() = default;
+	CpuPlacement(const CpuPlacement&) = delete;
+	CpuPlacement& operator=(const CpuPlacement&) = delete;
+
+	~CpuPlacement() {
+		if (slot_mutex_) {
+			CloseHandle(slot_mutex_);
+		}
+	}
+
+	// mode: {"off"}, {"auto"} - cores_per_worker физических ядер на Worker по свободному месту,
+	// {"node"} - все ядра узла numa_node, иначе - номера физических ядер. numa_node >= 0 ограничивает "auto" узлом.
+	// false - размещение не выполнено, error - причина (Worker работает без закрепления)
+	bool apply(const std::vector<std::string>& mode, int numa_node, int cores_per_worker, std::string& error) {
+		if (mode.empty() || mode[0].empty() || mode[0] == "off") {
+			return true;
+		}
+		cores_ = enumerateCores();
+		if (cores_.empty()) {
+			error = "cannot enumerate processor cores";
+			return false;
+		}
+		std::vector<Core> candidates;
+		for (const auto& core : cores_) {
+			if (numa_node < 0 || core.node == numa_node) {
+				candidates.push_back(core);
+			}
+		}
+		if (candidates.empty()) {
+			error = "no cores on NUMA node " + std::to_string(numa_node);
+			return false;
+		}
+
+		std::vector<Core> chosen;
+		if (mode[0] == "auto") {
+			const int per_worker = std::max(1, std::min(cores_per_worker, static_cast<int>(candidates.size())));
+			const int slots = static_cast<int>(candidates.size()) / per_worker;
+			slot_ = claimSlot(slots);
+			if (slot_ < 0) {
+				error = "all " + std::to_string(slots) + " placement slots are taken";
+				return false;
+			}
+			chosen.assign(candidates.begin() + slot_ * per_worker, candidates.begin() + (slot_ + 1) * per_worker);
+		}
+		else if (mode[0] == "node") {
+			if (numa_node < 0) {
+				error = "worker_numa_node is required for node placement";
+				return false;
+			}
+			chosen = candidates;
+		}
+		else {
+			for (const auto& item : mode) {
+				int index = -1;
+				try {
+					index = std::stoi(item);
+				}
+				catch (...) {
+				}
+				if (index < 0 || index >= static_cast<int>(cores_.size())) {
+					error = "invalid core number: " + item;
+					return false;
+				}
+				chosen.push_back(cores_[index]);
+			}
+		}
+
+		// Маска процесса - в пределах одной группы процессоров (до 64 логических)
+		KAFFINITY process_mask = 0;
+		node_ = chosen[0].node;
+		for (const auto& core : chosen) {
+			if (core.group != chosen[0].group) {
+				error = "cores span several processor groups";
+				return false;
+			}
+			process_mask |= core.mask;
+			if (core.node != node_) {
+				node_ = -1;
+			}
+		}
+		if (!SetProcessAffinityMask(GetCurrentProcess(), process_mask)) {
+			error = "SetProcessAffinityMask failed: " + std::to_string(GetLastError());
+			return false;
+		}
+		GROUP_AFFINITY thread_affinity = {};
+		thread_affinity.Group = chosen[0].group;
+		thread_affinity.Mask = chosen[0].mask;
+		if (!SetThreadGroupAffinity(GetCurrentThread(), &thread_affinity, nullptr)) {
+			error = "SetThreadGroupAffinity failed: " + std::to_string(GetLastError());
+			return false;
+		}
+		PROCESSOR_NUMBER ideal = {};
+		ideal.Group = chosen[0].group;
+		ideal.Number = static_cast<BYTE>(lowestProcessor(chosen[0].mask));
+		SetThreadIdealProcessorEx(GetCurrentThread(), &ideal, nullptr);  // Страницы выделяются на узле идеального процессора
+		chosen_ = chosen;
+		return true;
+	}
+
+	bool active() const {
+		return !chosen_.empty();
+	}
+
+	int node() const {
+		return node_;
+	}
+
+	// Физических ядер Worker'а: по одному потоку OpenCV на ядро
+	int coreCount() const {
+		return static_cast<int>(chosen_.size());
+	}
+
+	// "N physical cores on node X (slot S), processing thread on CPU G:P"
+	std::string describe() const {
+		std::string text = std::to_string(chosen_.size()) + " physical core(s) of " + std::to_string(cores_.size());
+		text += node_ >= 0 ? " on NUMA node " + std::to_string(node_) : " on several NUMA nodes";
+		if (slot_ >= 0) {
+			text += " (slot " + std::to_string(slot_) + ")";
+		}
+		text += ", processing thread on CPU " + std::to_string(chosen_[0].group) + ":"
+			+ std::to_string(lowestProcessor(chosen_[0].mask));
+		return text;
+	}
+
+	// Замер узла, на котором сейчас выполняется поток (раз в кадр)
+	void sample() {
+		if (!active() || node_ < 0) {
+			return;
+		}
+		PROCESSOR_NUMBER current = {};
+		GetCurrentProcessorNumberEx(&current);
+		USHORT node = 0;
+		if (GetNumaProcessorNodeEx(&current, &node)) {
+			samples_++;
+			if (static_cast<int>(node) != node_) {
+				remote_samples_++;
+			}
+		}
+	}
+
+	// Доля страниц буфера (из находящихся в памяти) на узле Worker'а, %. -1 - ОС не сообщила узел
+	double localPagePercent(const void* data, size_t bytes) const {
+		if (!active() || node_ < 0 || !data || bytes == 0) {
+			return -1.0;
+		}
+		SYSTEM_INFO system_info;
+		GetSystemInfo(&system_info);
+		const uintptr_t page = system_info.dwPageSize;
+		const uintptr_t begin = reinterpret_cast<uintptr_t>(data) & ~(page - 1);
+		const uintptr_t end = reinterpret_cast<uintptr_t>(data) + bytes;
+		std::vector<PSAPI_WORKING_SET_EX_INFORMATION> pages;
+		for (uintptr_t address = begin; address < end; address += page) {
+			PSAPI_WORKING_SET_EX_INFORMATION info = {};
+			info.VirtualAddress = reinterpret_cast<PVOID>(address);
+			pages.push_back(info);
+		}
+		if (!QueryWorkingSetEx(GetCurrentProcess(), pages.data(), static_cast<DWORD>(pages.size() * sizeof(pages[0])))) {
+			return -1.0;
+		}
+		size_t valid = 0, local = 0;
+		for (const auto& info : pages) {
+			if (info.VirtualAttributes.Valid) {
+				valid++;
+				if (static_cast<int>(info.VirtualAttributes.Node) == node_) {
+					local++;
+				}
+			}
+		}
+		return valid ? local * 100.0 / valid : -1.0;
+	}
+
+	// "поток на чужом узле X% кадров, страницы буфера на своем узле Y%"
+	void printStats(std::ostream& out, const std::string& prefix, const void* buffer, size_t bytes) const {
+		if (!active() || node_ < 0) {
+			return;
+		}
+		out << prefix << "node " << node_ << ", thread off-node "
+			<< (samples_ ? remote_samples_ * 100.0 / samples_ : 0.0) << "% of frames";
+		const double local = localPagePercent(buffer, bytes);
+		if (local >= 0.0) {
+			out << ", output buffer pages local " << local << "%";
+		}
+		out << std::endl;
+	}
+};
@@ -0,0 +1,682 @@
+﻿#pragma once
+#include <opencv2/opencv.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <climits>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Ядра эффекта Scanner Darkly (построчное назначение палитры, целочисленный k-means, median cut)
+namespace effect_kernels {
+
+	const int kMaxSimdCenters = 16; // Максимум центров для SIMD-ядра назначения
+
+	// Ядро назначения строки с параметрами времени компиляции: Count > 0 - число центров (циклы по центрам
+	// разворачиваются), Contour >= 0 - значение контура (без чтения из аргумента). Count = 0 / Contour = -1 - из аргументов.
+	// Если аргументы не совпали со специализацией, строка уходит в общий вариант
+	template <int Count, int Contour>
+	inline void assignRowNearestT(const uchar* src, uchar* dst, uchar* labels, int width,
+		const cv::Vec3b* palette, int count, const uchar* mask, uchar contour) {
+		if ((Count > 0 && count != Count) || (Contour >= 0 && contour != Contour)) {
+			assignRowNearestT<0, -1>(src, dst, labels, width, palette, count, mask, contour);
+			return;
+		}
+		const int n = Count > 0 ? Count : count;  // Константа в специализациях
+		const uchar c = Contour >= 0 ? static_cast<uchar>(Contour) : contour;
+		int x = 0;
+#if CV_SIMD
+		if (n <= kMaxSimdCenters) {
+			const int lanes = cv::VTraits<cv::v_uint8>::vlanes();  // Пикселей за итерацию
+			const cv::v_uint8 contour8 = cv::vx_setall_u8(c);
+			const cv::v_uint8 zero8 = cv::vx_setzero_u8();
+			for (; x <= width - lanes; x += lanes) {
+				cv::v_uint8 b8, g8, r8;
+				cv::v_load_deinterleave(src + 3 * x, b8, g8, r8);  // BGRBGR... -> B, G, R
+
+				cv::v_uint16 b_lo, b_hi, g_lo, g_hi, r_lo, r_hi;  // Расширение до 16 бит
+				cv::v_expand(b8, b_lo, b_hi);
+				cv::v_expand(g8, g_lo, g_hi);
+				cv::v_expand(r8, r_lo, r_hi);
+				const cv::v_int16 pb[2] = { cv::v_reinterpret_as_s16(b_lo), cv::v_reinterpret_as_s16(b_hi) };
+				const cv::v_int16 pg[2] = { cv::v_reinterpret_as_s16(g_lo), cv::v_reinterpret_as_s16(g_hi) };
+				const cv::v_int16 pr[2] = { cv::v_reinterpret_as_s16(r_lo), cv::v_reinterpret_as_s16(r_hi) };
+
+				cv::v_int16 out_b[2], out_g[2], out_r[2], out_i[2];  // Лучший цвет и индекс по половинам
+				for (int h = 0; h < 2; h++) {
+					cv::v_int32 best_lo = cv::vx_setall_s32(INT_MAX), best_hi = cv::vx_setall_s32(INT_MAX);
+					out_b[h] = out_g[h] = out_r[h] = out_i[h] = cv::vx_setzero_s16();
+					for (int j = 0; j < n; j++) {
+						const cv::v_int16 cb = cv::vx_setall_s16(palette[j][0]);
+						const cv::v_int16 cg = cv::vx_setall_s16(palette[j][1]);
+						const cv::v_int16 cr = cv::vx_setall_s16(palette[j][2]);
+						const cv::v_int16 db = cv::v_sub(pb[h], cb);  // Разности в диапазоне [-255, 255]
+						const cv::v_int16 dg = cv::v_sub(pg[h], cg);
+						const cv::v_int16 dr = cv::v_sub(pr[h], cr);
+
+						cv::v_int32 d_lo, d_hi, t_lo, t_hi;  // Квадраты в 32 битах (до 3 * 255^2)
+						cv::v_mul_expand(db, db, d_lo, d_hi);
+						cv::v_mul_expand(dg, dg, t_lo, t_hi);
+						d_lo = cv::v_add(d_lo, t_lo);
+						d_hi = cv::v_add(d_hi, t_hi);
+						cv::v_mul_expand(dr, dr, t_lo, t_hi);
+						d_lo = cv::v_add(d_lo, t_lo);
+						d_hi = cv::v_add(d_hi, t_hi);
+
+						const cv::v_int32 m_lo = cv::v_lt(d_lo, best_lo);  // Строго меньше - при равенстве побеждает первый центр
+						const cv::v_int32 m_hi = cv::v_lt(d_hi, best_hi);
+						best_lo = cv::v_select(m_lo, d_lo, best_lo);
+						best_hi = cv::v_select(m_hi, d_hi, best_hi);
+						const cv::v_int16 m = cv::v_pack(m_lo, m_hi);  // Маски -1/0 в 16 бит
+						out_b[h] = cv::v_select(m, cb, out_b[h]);
+						out_g[h] = cv::v_select(m, cg, out_g[h]);
+						out_r[h] = cv::v_select(m, cr, out_r[h]);
+						out_i[h] = cv::v_select(m, cv::vx_setall_s16(static_cast<short>(j)), out_i[h]);
+					}
+				}
+
+				if (dst) {
+					cv::v_uint8 res_b = cv::v_pack_u(out_b[0], out_b[1]);
+					cv::v_uint8 res_g = cv::v_pack_u(out_g[0], out_g[1]);
+					cv::v_uint8 res_r = cv::v_pack_u(out_r[0], out_r[1]);
+					if (mask) {
+						const cv::v_uint8 m = cv::v_ne(cv::vx_load(mask + x), zero8);  // Контур поверх цвета палитры
+						res_b = cv::v_select(m, contour8, res_b);
+						res_g = cv::v_select(m, contour8, res_g);
+						res_r = cv::v_select(m, contour8, res_r);
+					}
+					cv::v_store_interleave(dst + 3 * x, res_b, res_g, res_r);  // Победивший цвет прямо в выходную строку
+				}
+				if (labels) {
+					cv::v_store(labels + x, cv::v_pack_u(out_i[0], out_i[1]));
+				}
+			}
+			cv::vx_cleanup();
+		}
+#endif
+		// Скалярный путь (хвост строки или более 16 центров) с той же целочисленной метрикой
+		for (; x < width; x++) {
+			const uchar* p = src + 3 * x;
+			int best_dist = INT_MAX;
+			int best_idx = 0;
+			for (int j = 0; j < n; j++) {
+				int db = p[0] - palette[j][0];
+				int dg = p[1] - palette[j][1];
+				int dr = p[2] - palette[j][2];
+				int dist = db * db + dg * dg + dr * dr;
+				if (dist < best_dist) {
+					best_dist = dist;
+					best_idx = j;
+				}
+			}
+			if (dst) {
+				uchar* q = dst + 3 * x;
+				if (mask && mask[x]) {
+					q[0] = q[1] = q[2] = c;
+				}
+				else {
+					q[0] = palette[best_idx][0];
+					q[1] = palette[best_idx][1];
+					q[2] = palette[best_idx][2];
+				}
+			}
+			if (labels) {
+				labels[x] = static_cast<uchar>(best_idx);
+			}
+		}
+	}
+
+	// Назначение строки BGR ближайшему цвету палитры (квадрат евклидова расстояния в целых числах).
+	// dst - BGR-строка результата, labels - индексы центров (каждый из двух может быть nullptr).
+	// mask - строка маски контуров (может быть nullptr): при mask[x] != 0 в dst пишется contour во все каналы.
+	// SIMD-путь на универсальных интринсиках OpenCV (SSE/AVX2/NEON), хвост строки - скалярный.
+	inline void assignRowNearest(const uchar* src, uchar* dst, uchar* labels, int width,
+		const cv::Vec3b* palette, int count, const uchar* mask = nullptr, uchar contour = 0) {
+		assignRowNearestT<0, -1>(src, dst, labels, width, palette, count, mask, contour);
+	}
+
+	// Указатель на ядро назначения строки (общее или специализированное)
+	typedef void (*AssignRowFn)(const uchar* src, uchar* dst, uchar* labels, int width,
+		const cv::Vec3b* palette, int count, const uchar* mask, uchar contour);
+
+	// Выбор ядра для частых настроек: 4/6/8/16 центров и черные (0) или белые (255) контуры, иначе - общее
+	inline AssignRowFn selectAssignRow(int count, uchar contour) {
+		if (contour != 0 && contour != 255) {
+			return &assignRowNearestT<0, -1>;
+		}
+		const bool black = contour == 0;
+		switch (count) {
+		case 4: return black ? &assignRowNearestT<4, 0> : &assignRowNearestT<4, 255>;
+		case 6: return black ? &assignRowNearestT<6, 0> : &assignRowNearestT<6, 255>;
+		case 8: return black ? &assignRowNearestT<8, 0> : &assignRowNearestT<8, 255>;
+		case 16: return black ? &assignRowNearestT<16, 0> : &assignRowNearestT<16, 255>;
+		default: return &assignRowNearestT<0, -1>;
+		}
+	}
+
+	// Цвета палитры по готовым меткам с наложением контуров (mask == nullptr - без контуров).
+	// Для полного k-means, где метки уже посчитаны cv::kmeans.
+	inline void paletteRowWithContours(const int* labels, const uchar* mask, uchar* dst, int width,
+		const cv::Vec3b* palette, uchar contour) {
+		for (int x = 0; x < width; x++) {
+			uchar* q = dst + 3 * x;
+			if (mask && mask[x]) {
+				q[0] = q[1] = q[2] = contour;
+			}
+			else {
+				const cv::Vec3b& c = palette[labels[x]];
+				q[0] = c[0];
+				q[1] = c[1];
+				q[2] = c[2];
+			}
+		}
+	}
+
+	// Маска 1 бит на пиксель: бит x строки - в слове x / 64, разряд x % 64 (младший - меньший x).
+	// Разряды за cols в последнем слове строки нулевые
+	struct BitMask {
+		int rows = 0;
+		int cols = 0;
+		int words = 0;                // 64-битных слов на строку
+		std::vector<uint64_t> bits;   // rows * words слов
+
+		// Размер без обнуления (память переиспользуется, пока размер не растет)
+		void create(int r, int c) {
+			rows = r;
+			cols = c;
+			words = (c + 63) / 64;
+			bits.resize(static_cast<size_t>(r) * words);
+		}
+
+		uint64_t* row(int y) {
+			return bits.data() + static_cast<size_t>(y) * words;
+		}
+
+		const uint64_t* row(int y) const {
+			return bits.data() + static_cast<size_t>(y) * words;
+		}
+	};
+
+	// Номер младшего установленного бита (w != 0)
+	inline int lowestBit(uint64_t w) {
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, w);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctzll(w);
+#endif
+	}
+
+	// Упаковка байтовой маски (CV_8UC1, ненулевой байт - контур) в биты
+	inline void packMask(const cv::Mat& mask, BitMask& dst) {
+		dst.create(mask.rows, mask.cols);
+		for (int y = 0; y < mask.rows; y++) {
+			const uchar* src = mask.ptr<uchar>(y);
+			uint64_t* out = dst.row(y);
+			for (int w = 0; w < dst.words; w++) {
+				const int x0 = w * 64;
+				const int n = std::min(64, mask.cols - x0);
+				uint64_t word = 0;
+				for (int i = 0; i < n; i++) {
+					word |= static_cast<uint64_t>(src[x0 + i] != 0) << i;
+				}
+				out[w] = word;
+			}
+		}
+	}
+
+	// Распаковка в байтовую маску 0/255 (для путей, которым нужна cv::Mat)
+	inline void unpackMask(const BitMask& src, cv::Mat& dst) {
+		dst.create(src.rows, src.cols, CV_8UC1);
+		for (int y = 0; y < src.rows; y++) {
+			const uint64_t* in = src.row(y);
+			uchar* out = dst.ptr<uchar>(y);
+			for (int x = 0; x < src.cols; x++) {
+				out[x] = ((in[x >> 6] >> (x & 63)) & 1) ? 255 : 0;
+			}
+		}
+	}
+
+	// Сдвиг строки битов: бит x результата = бит (x + s) исходной строки, за пределами строки - 0
+	inline void shiftRowBits(const uint64_t* in, uint64_t* out, int words, int s) {
+		const int ws = (s >= 0 ? s : -s) / 64;  // Сдвиг в словах
+		const int bs = (s >= 0 ? s : -s) % 64;  // Сдвиг внутри слова
+		for (int i = 0; i < words; i++) {
+			if (s >= 0) {
+				const int j = i + ws;
+				const uint64_t lo = j < words ? in[j] >> bs : 0;
+				const uint64_t hi = (bs && j + 1 < words) ? in[j + 1] << (64 - bs) : 0;
+				out[i] = lo | hi;
+			}
+			else {
+				const int j = i - ws;
+				const uint64_t hi = j >= 0 ? in[j] << bs : 0;
+				const uint64_t lo = (bs && j - 1 >= 0) ? in[j - 1] >> (64 - bs) : 0;
+				out[i] = hi | lo;
+			}
+		}
+	}
+
+	// OR битов строки на расстояниях 0..length-1 в сторону direction (+1 - к большим x, -1 - к меньшим):
+	// удвоение покрытия сдвигами, log2(length) проходов. tmp - рабочая строка
+	inline void spreadRowBits(const uint64_t* in, uint64_t* acc, uint64_t* tmp, int words, int length, int direction) {
+		std::copy(in, in + words, acc);
+		for (int covered = 1; covered < length; ) {
+			const int step = std::min(covered, length - covered);
+			shiftRowBits(acc, tmp, words, direction * step);
+			for (int i = 0; i < words; i++) {
+				acc[i] |= tmp[i];
+			}
+			covered += step;
+		}
+	}
+
+	// Дилатация прямоугольным ядром kernel x kernel (якорь в центре, как cv::dilate с MORPH_RECT) по 64 пикселя
+	// за операцию: по горизонтали - сдвиги в обе стороны от пикселя, по вертикали - OR строк.
+	// scratch - буфер горизонтального прохода (+2 рабочие строки); dst не может совпадать с src
+	inline void dilateBits(const BitMask& src, int kernel, BitMask& dst, BitMask& scratch) {
+		dst.create(src.rows, src.cols);
+		scratch.create(src.rows + 2, src.cols);
+		const int anchor = kernel / 2;
+		const int words = src.words;
+		if (words == 0) {
+			return;
+		}
+		const uint64_t tail = (src.cols % 64) ? (~0ULL >> (64 - src.cols % 64)) : ~0ULL;  // Разряды в пределах cols
+		uint64_t* left = scratch.row(src.rows);
+		uint64_t* tmp = scratch.row(src.rows + 1);
+		for (int y = 0; y < src.rows; y++) {
+			uint64_t* acc = scratch.row(y);
+			spreadRowBits(src.row(y), acc, tmp, words, kernel - anchor, 1);  // [x, x + kernel - anchor)
+			spreadRowBits(src.row(y), left, tmp, words, anchor + 1, -1);     // [x - anchor, x]
+			for (int i = 0; i < words; i++) {
+				acc[i] |= left[i];
+			}
+			acc[words - 1] &= tail;
+		}
+		for (int y = 0; y < src.rows; y++) {
+			uint64_t* out = dst.row(y);
+			const int top = std::max(0, y - anchor);
+			const int bottom = std::min(src.rows, y - anchor + kernel);
+			std::fill(out, out + words, 0);
+			for (int r = top; r < bottom; r++) {
+				const uint64_t* in = scratch.row(r);
+				for (int i = 0; i < words; i++) {
+					out[i] |= in[i];
+				}
+			}
+		}
+	}
+
+	// Наложение контура по строке битовой маски: обход только установленных битов (пустые слова пропускаются).
+	// bit_offset - номер бита, соответствующего dst[0] (строка dst может быть частью строки маски)
+	inline void overlayRowBits(const uint64_t* bits, int bit_offset, uchar* dst, int width, uchar contour) {
+		for (int x = 0; x < width; ) {
+			const int bit = x + bit_offset;
+			const int avail = std::min(64 - (bit & 63), width - x);  // Пикселей из текущего слова
+			uint64_t word = bits[bit >> 6] >> (bit & 63);
+			if (avail < 64) {
+				word &= (1ULL << avail) - 1;
+			}
+			while (word) {
+				uchar* q = dst + 3 * (x + lowestBit(word));
+				q[0] = q[1] = q[2] = contour;
+				word &= word - 1;
+			}
+			x += avail;
+		}
+	}
+
+	// Увеличение маски контуров в scale раз с сохранением тонких линий: пиксель контура переходит в центр
+	// своего блока scale x scale, соседние (8-связные) пиксели контура соединяются отрезками толщиной 1.
+	// dst - маска полного размера, обнуленная вызывающим (может быть не кратна scale - лишнее отсекается)
+	inline void upscaleEdgesThin(const cv::Mat& edges, int scale, cv::Mat& dst) {
+		const int half = scale / 2;
+		auto put = [&dst](int x, int y) {
+			if (x < dst.cols && y < dst.rows) {
+				dst.ptr<uchar>(y)[x] = 255;
+			}
+		};
+		for (int y = 0; y < edges.rows; y++) {
+			const uchar* row = edges.ptr<uchar>(y);
+			const uchar* next = (y + 1 < edges.rows) ? edges.ptr<uchar>(y + 1) : nullptr;
+			for (int x = 0; x < edges.cols; x++) {
+				if (!row[x]) {
+					continue;
+				}
+				const int cx = x * scale + half;  // Центр блока в полном кадре
+				const int cy = y * scale + half;
+				put(cx, cy);
+				const bool right = x + 1 < edges.cols && row[x + 1];
+				const bool down = next && next[x];
+				const bool down_right = next && x + 1 < edges.cols && next[x + 1];
+				const bool down_left = next && x > 0 && next[x - 1];
+				for (int i = 1; i <= scale; i++) {  // Отрезки к соседям справа и снизу (остальные рисует сосед)
+					if (right) put(cx + i, cy);
+					if (down) put(cx, cy + i);
+					if (down_right) put(cx + i, cy + i);
+					if (down_left) put(cx - i, cy + i);
+				}
+			}
+		}
+	}
+
+	// Рабочие буферы целочисленного k-means (переиспользуются между кадрами)
+	struct KMeansIntBuffers {
+		std::vector<uchar> labels;          // Метки выборки (индекс центра)
+		std::vector<int> distances;         // Квадрат расстояния до ближайшего выбранного центра (k-means++)
+		std::vector<uint32_t> chunk_sums;   // Суммы B, G, R по центрам в пределах блока выборки
+		std::vector<uint32_t> chunk_counts; // Число точек по центрам в пределах блока
+		std::vector<int64_t> sums;          // Суммы B, G, R по центрам за проход
+		std::vector<int64_t> counts;        // Число точек по центрам за проход
+		std::vector<cv::Vec3b> centers;     // Центры текущей попытки
+		std::vector<cv::Vec3b> best;        // Центры лучшей попытки (результат)
+	};
+
+	// Квадрат евклидова расстояния между 8-битными цветами BGR
+	inline int distanceSq(const cv::Vec3b& a, const cv::Vec3b& b) {
+		int db = a[0] - b[0];
+		int dg = a[1] - b[1];
+		int dr = a[2] - b[2];
+		return db * db + dg * dg + dr * dr;
+	}
+
+	// Начальные центры k-means++: следующий центр выбирается с вероятностью, пропорциональной
+	// квадрату расстояния до ближайшего уже выбранного
+	inline void initCentersPP(const cv::Vec3b* samples, int count, int k, cv::RNG& rng, KMeansIntBuffers& buf) {
+		buf.centers[0] = samples[rng.uniform(0, count)];
+		int64_t total = 0;
+		for (int i = 0; i < count; i++) {
+			buf.distances[i] = distanceSq(samples[i], buf.centers[0]);
+			total += buf.distances[i];
+		}
+		for (int c = 1; c < k; c++) {
+			int pick = rng.uniform(0, count);  // Все точки совпадают с центрами - любая
+			if (total > 0) {
+				int64_t target = static_cast<int64_t>(rng.uniform(0.0, 1.0) * static_cast<double>(total));
+				for (pick = 0; pick < count - 1 && target >= buf.distances[pick]; pick++) {
+					target -= buf.distances[pick];
+				}
+			}
+			buf.centers[c] = samples[pick];
+			total = 0;
+			for (int i = 0; i < count; i++) {
+				buf.distances[i] = std::min(buf.distances[i], distanceSq(samples[i], buf.centers[c]));
+				total += buf.distances[i];
+			}
+		}
+	}
+
+	// Целочисленный k-means по 8-битным BGR без преобразования в CV_32F.
+	// Назначение - SIMD-ядро assignRowNearest (разности в 16-битных lanes), суммы центров - uint32
+	// по блокам до 2^24 точек (255 * 2^24 < 2^32), затем в int64. Центры округляются до целых.
+	// Останов, как в cv::kmeans с EPS 1.0: сдвиг каждого центра не больше 1 (в квадрате).
+	// Пустой кластер сохраняет прежний центр. Результат - центры лучшей из attempts попыток в buf.best,
+	// возвращается компактность (сумма квадратов расстояний) лучшей попытки.
+	inline int64_t kmeansInt(const cv::Vec3b* samples, int count, int k, int max_iter, int attempts,
+		cv::RNG& rng, KMeansIntBuffers& buf) {
+		k = std::max(1, std::min({ k, count, 256 }));  // Метки хранятся в uchar
+		const int chunk = 1 << 24;  // Точек на блок uint32-сумм
+		buf.labels.resize(count);
+		buf.distances.resize(count);
+		buf.chunk_sums.resize(static_cast<size_t>(k) * 3);
+		buf.chunk_counts.resize(k);
+		buf.sums.resize(static_cast<size_t>(k) * 3);
+		buf.counts.resize(k);
+		buf.centers.resize(k);
+		buf.best.resize(k);
+		const uchar* data = reinterpret_cast<const uchar*>(samples);
+
+		int64_t best_compactness = INT64_MAX;
+		for (int a = 0; a < attempts; a++) {
+			initCentersPP(samples, count, k, rng, buf);
+			int64_t compactness = 0;
+			for (int iter = 0; iter < max_iter; iter++) {
+				// Назначение: только метки, цвет не пишется
+				assignRowNearest(data, nullptr, buf.labels.data(), count, buf.centers.data(), k);
+
+				// Суммы по центрам и компактность относительно текущих центров
+				std::fill(buf.sums.begin(), buf.sums.end(), 0);
+				std::fill(buf.counts.begin(), buf.counts.end(), 0);
+				compactness = 0;
+				for (int start = 0; start < count; start += chunk) {
+					const int end = std::min(count, start + chunk);
+					std::fill(buf.chunk_sums.begin(), buf.chunk_sums.end(), 0u);
+					std::fill(buf.chunk_counts.begin(), buf.chunk_counts.end(), 0u);
+					for (int i = start; i < end; i++) {
+						const int c = buf.labels[i];
+						uint32_t* s = &buf.chunk_sums[static_cast<size_t>(c) * 3];
+						s[0] += samples[i][0];
+						s[1] += samples[i][1];
+						s[2] += samples[i][2];
+						buf.chunk_counts[c]++;
+						compactness += distanceSq(samples[i], buf.centers[c]);
+					}
+					for (int c = 0; c < k; c++) {
+						buf.sums[c * 3] += buf.chunk_sums[c * 3];
+						buf.sums[c * 3 + 1] += buf.chunk_sums[c * 3 + 1];
+						buf.sums[c * 3 + 2] += buf.chunk_sums[c * 3 + 2];
+						buf.counts[c] += buf.chunk_counts[c];
+					}
+				}
+
+				// Новые центры (округление к ближайшему) и максимальный сдвиг
+				int max_shift = 0;
+				for (int c = 0; c < k; c++) {
+					if (buf.counts[c] == 0) {
+						continue;  // Пустой кластер - центр на месте
+					}
+					const int64_t n = buf.counts[c];
+					const cv::Vec3b center(
+						static_cast<uchar>((buf.sums[c * 3] + n / 2) / n),
+						static_cast<uchar>((buf.sums[c * 3 + 1] + n / 2) / n),
+						static_cast<uchar>((buf.sums[c * 3 + 2] + n / 2) / n));
+					max_shift = std::max(max_shift, distanceSq(center, buf.centers[c]));
+					buf.centers[c] = center;
+				}
+				if (max_shift <= 1) {
+					break;
+				}
+			}
+			if (compactness < best_compactness) {
+				best_compactness = compactness;
+				std::copy(buf.centers.begin(), buf.centers.end(), buf.best.begin());
+			}
+		}
+		return best_compactness;
+	}
+
+	// Рабочие буферы median cut (переиспользуются между кадрами)
+	struct MedianCutBuffers {
+		struct Box {
+			int begin, end;     // Диапазон ячеек в cells
+			int lo[3], hi[3];   // Границы по B, G, R в 5-битных единицах
+			uint64_t pixels;    // Пикселей в ячейках коробки
+		};
+		std::vector<uint32_t> counts;   // Гистограмма 32x32x32 (BGR 5:5:5)
+		std::vector<uint64_t> sums;     // Суммы B, G, R исходных 8-битных значений по ячейкам
+		std::vector<int> cells;         // Индексы непустых ячеек
+		std::vector<Box> boxes;         // Коробки разбиения
+	};
+
+	// Канал c (0 - B, 1 - G, 2 - R) ячейки гистограммы 5:5:5
+	inline int histogramChannel(int cell, int c) {
+		return (cell >> (10 - 5 * c)) & 31;
+	}
+
+	// Границы и число пикселей коробки по ее ячейкам
+	inline void medianCutBounds(const MedianCutBuffers& buf, MedianCutBuffers::Box& box) {
+		box.pixels = 0;
+		for (int c = 0; c < 3; c++) {
+			box.lo[c] = 31;
+			box.hi[c] = 0;
+		}
+		for (int i = box.begin; i < box.end; i++) {
+			const int cell = buf.cells[i];
+			for (int c = 0; c < 3; c++) {
+				const int v = histogramChannel(cell, c);
+				box.lo[c] = std::min(box.lo[c], v);
+				box.hi[c] = std::max(box.hi[c], v);
+			}
+			box.pixels += buf.counts[cell];
+		}
+	}
+
+	// Палитра median cut по гистограмме 5 бит на канал: без случайных чисел, одинаковые пиксели - одинаковая палитра
+	// на любой машине. Делится коробка с наибольшим (пикселей x длина длинной стороны) по длинной стороне
+	// в точке медианы пикселей; цвет коробки - среднее исходных 8-битных значений ее пикселей.
+	// Палитра может быть короче k, если непустых ячеек меньше
+	inline void medianCutPalette(const cv::Vec3b* samples, int count, int k, MedianCutBuffers& buf,
+		std::vector<cv::Vec3b>& palette) {
+		const int cells = 1 << 15;
+		buf.counts.assign(cells, 0u);
+		buf.sums.assign(static_cast<size_t>(cells) * 3, 0u);
+		for (int i = 0; i < count; i++) {
+			const cv::Vec3b& p = samples[i];
+			const int cell = ((p[0] >> 3) << 10) | ((p[1] >> 3) << 5) | (p[2] >> 3);
+			buf.counts[cell]++;
+			uint64_t* s = &buf.sums[static_cast<size_t>(cell) * 3];
+			s[0] += p[0];
+			s[1] += p[1];
+			s[2] += p[2];
+		}
+		buf.cells.clear();
+		for (int cell = 0; cell < cells; cell++) {
+			if (buf.counts[cell]) {
+				buf.cells.push_back(cell);
+			}
+		}
+		palette.clear();
+		if (buf.cells.empty()) {
+			return;
+		}
+
+		buf.boxes.clear();
+		MedianCutBuffers::Box root;
+		root.begin = 0;
+		root.end = static_cast<int>(buf.cells.size());
+		medianCutBounds(buf, root);
+		buf.boxes.push_back(root);
+		k = std::max(1, std::min(k, 256));  // Метки палитры хранятся в uchar
+		while (static_cast<int>(buf.boxes.size()) < k) {
+			// Выбор коробки (при равенстве - первая: порядок не зависит от данных других кадров)
+			int split = -1;
+			int split_channel = 0;
+			uint64_t best_score = 0;
+			for (size_t b = 0; b < buf.boxes.size(); b++) {
+				const MedianCutBuffers::Box& box = buf.boxes[b];
+				if (box.end - box.begin < 2) {
+					continue;  // Одна ячейка - делить нечего
+				}
+				int channel = 0;
+				for (int c = 1; c < 3; c++) {
+					if (box.hi[c] - box.lo[c] > box.hi[channel] - box.lo[channel]) {
+						channel = c;
+					}
+				}
+				const uint64_t score = box.pixels * static_cast<uint64_t>(box.hi[channel] - box.lo[channel]);
+				if (score > best_score) {
+					best_score = score;
+					split = static_cast<int>(b);
+					split_channel = channel;
+				}
+			}
+			if (split < 0) {
+				break;
+			}
+
+			// Сортировка по каналу, при равенстве - по индексу ячейки (полный порядок - результат детерминирован)
+			MedianCutBuffers::Box box = buf.boxes[split];
+			const int channel = split_channel;
+			std::sort(buf.cells.begin() + box.begin, buf.cells.begin() + box.end, [channel](int a, int b) {
+				const int va = histogramChannel(a, channel);
+				const int vb = histogramChannel(b, channel);
+				return va != vb ? va < vb : a < b;
+			});
+			// Медиана пикселей; обе половины непустые
+			uint64_t accumulated = 0;
+			int middle = box.begin + 1;
+			for (int i = box.begin; i < box.end - 1; i++) {
+				accumulated += buf.counts[buf.cells[i]];
+				middle = i + 1;
+				if (accumulated * 2 >= box.pixels) {
+					break;
+				}
+			}
+			MedianCutBuffers::Box upper = box;
+			box.end = middle;
+			upper.begin = middle;
+			medianCutBounds(buf, box);
+			medianCutBounds(buf, upper);
+			buf.boxes[split] = box;
+			buf.boxes.push_back(upper);
+		}
+
+		// Цвет коробки - округленное среднее ее пикселей
+		for (const MedianCutBuffers::Box& box : buf.boxes) {
+			uint64_t sum[3] = { 0, 0, 0 };
+			for (int i = box.begin; i < box.end; i++) {
+				const uint64_t* s = &buf.sums[static_cast<size_t>(buf.cells[i]) * 3];
+				sum[0] += s[0];
+				sum[1] += s[1];
+				sum[2] += s[2];
+			}
+			const uint64_t n = box.pixels;
+			palette.emplace_back(
+				static_cast<uchar>((sum[0] + n / 2) / n),
+				static_cast<uchar>((sum[1] + n / 2) / n),
+				static_cast<uchar>((sum[2] + n / 2) / n));
+		}
+	}
+
+	// Одномерный k-means (Ллойд) по гистограмме яркости 256 бинов: итерация - проход по 256 бинам,
+	// а не по пикселям. Начальные уровни - середины k равных по числу пикселей квантилей (без случайности).
+	// Пустой кластер сохраняет прежний уровень. levels - возрастающие уровни (длина k, от 1 до 256)
+	inline void grayLevelsKMeans(const uint32_t* hist, int k, int max_iter, std::vector<uchar>& levels) {
+		k = std::max(1, std::min(k, 256));
+		uint64_t total = 0;
+		for (int v = 0; v < 256; v++) {
+			total += hist[v];
+		}
+		levels.resize(k);
+		uint64_t accumulated = 0;
+		int next = 0;
+		for (int v = 0; v < 256 && next < k; v++) {
+			accumulated += hist[v];
+			while (next < k && accumulated * 2 * k > (2 * static_cast<uint64_t>(next) + 1) * total) {
+				levels[next++] = static_cast<uchar>(v);
+			}
+		}
+		for (; next < k; next++) {
+			levels[next] = next > 0 ? levels[next - 1] : 0;  // Пустая гистограмма
+		}
+
+		for (int iter = 0; iter < max_iter; iter++) {
+			// Границы кластеров - середины между соседними уровнями (уровни упорядочены)
+			bool changed = false;
+			int v = 0;
+			for (int c = 0; c < k; c++) {
+				const int upper = c + 1 < k ? (levels[c] + levels[c + 1]) / 2 : 255;
+				uint64_t count = 0, sum = 0;
+				for (; v <= upper; v++) {
+					count += hist[v];
+					sum += static_cast<uint64_t>(hist[v]) * v;
+				}
+				if (count == 0) {
+					continue;
+				}
+				const uchar level = static_cast<uchar>((sum + count / 2) / count);
+				changed |= level != levels[c];
+				levels[c] = level;
+			}
+			std::sort(levels.begin(), levels.end());
+			if (!changed) {
+				break;
+			}
+		}
+	}
+
+}
@@ -0,0 +1,269 @@
+﻿#pragma once
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <stdexcept>
+#include "scanner_darkly_effect.hpp"
+
+// Цепочка эффектов Worker'а: этапы создаются по именам из реестра, порядок задается в config.txt (effect_chain)
+
+// Общие данные этапов одного кадра (маска контуров от edges для overlay)
+struct EffectContext {
+	cv::Mat edges;  // Маска контуров (CV_8UC1), пустая - контуры еще не посчитаны
+};
+
+// Этап цепочки
+class EffectStage {
+public:
+	virtual ~EffectStage() = default;
+
+	virtual std::string name() const = 0;
+
+	// Обработка кадра: input -> output (output не пересекается с input)
+	virtual void process(const cv::Mat& input, cv::Mat& output, EffectContext& context) = 0;
+
+	// false - этап только анализирует кадр (пишет в context), изображение идет дальше без копии
+	virtual bool transformsImage() const {
+		return true;
+	}
+};
+
+// Полный эффект Scanner Darkly (эффект Worker'а с настройками effect_*)
+class ScannerDarklyStage : public EffectStage {
+private:
+	ScannerDarklyEffect& effect_;
+
+public:
+	explicit ScannerDarklyStage(ScannerDarklyEffect& effect) : effect_(effect) {}
+
+	std::string name() const override {
+		return "scanner_darkly";
+	}
+
+	void process(const cv::Mat& input, cv::Mat& output, EffectContext&) override {
+		effect_.applyEffect(input, output);
+	}
+};
+
+// Постеризация с фиксированным числом бит на канал: одна выборка из LUT на байт, без k-means.
+// Дешевая замена квантования при перегрузке
+class PosterizeStage : public EffectStage {
+private:
+	cv::Mat lut_;  // 256 значений: старшие bits бит + середина отброшенного диапазона
+
+public:
+	explicit PosterizeStage(int bits) {
+		bits = std::max(1, std::min(bits, 8));
+		const int shift = 8 - bits;
+		lut_.create(1, 256, CV_8U);
+		for (int v = 0; v < 256; v++) {
+			lut_.at<uchar>(v) = static_cast<uchar>(((v >> shift) << shift) + (shift > 0 ? (1 << (shift - 1)) : 0));
+		}
+	}
+
+	std::string name() const override {
+		return "posterize";
+	}
+
+	void process(const cv::Mat& input, cv::Mat& output, EffectContext&) override {
+		cv::LUT(input, lut_, output);  // Одна таблица на все каналы
+	}
+};
+
+// Контуры Кэнни в context.edges (изображение не меняется)
+class EdgesStage : public EffectStage {
+private:
+	int low_threshold_;
+	int high_threshold_;
+	int kernel_size_;
+	cv::Mat gray_, blur_;  // Буферы переиспользуются между кадрами
+
+public:
+	EdgesStage(int low_threshold, int high_threshold, int kernel_size)
+		: low_threshold_(low_threshold), high_threshold_(high_threshold), kernel_size_(kernel_size) {}
+
+	std::string name() const override {
+		return "edges";
+	}
+
+	bool transformsImage() const override {
+		return false;
+	}
+
+	void process(const cv::Mat& input, cv::Mat&, EffectContext& context) override {
+		const cv::Mat* gray = &input;  // Серый кадр - без преобразования
+		if (input.channels() != 1) {
+			cv::cvtColor(input, gray_, cv::COLOR_BGR2GRAY);
+			gray = &gray_;
+		}
+		cv::GaussianBlur(*gray, blur_, cv::Size(kernel_size_, kernel_size_), 0);
+		cv::Canny(blur_, context.edges, low_threshold_, high_threshold_);
+	}
+};
+
+// Наложение контуров из context.edges (после resize маска масштабируется ближайшим соседом)
+class OverlayStage : public EffectStage {
+private:
+	bool black_contours_;
+	cv::Mat scaled_edges_;
+
+public:
+	explicit OverlayStage(bool black_contours) : black_contours_(black_contours) {}
+
+	std::string name() const override {
+		return "overlay";
+	}
+
+	void process(const cv::Mat& input, cv::Mat& output, EffectContext& context) override {
+		if (context.edges.empty()) {
+			throw std::logic_error("overlay stage requires an edges stage before it");
+		}
+		const cv::Mat* edges = &context.edges;
+		if (context.edges.size() != input.size()) {
+			cv::resize(context.edges, scaled_edges_, input.size(), 0, 0, cv::INTER_NEAREST);
+			edges = &scaled_edges_;
+		}
+		input.copyTo(output);
+		const double contour = black_contours_ ? 0 : 255;  // Белый - как насыщение в combineEffect
+		output.setTo(cv::Scalar(contour, contour, contour), *edges);
+	}
+};
+
+// Масштабирование кадра (percent от исходного размера)
+class ResizeStage : public EffectStage {
+private:
+	int percent_;
+
+public:
+	explicit ResizeStage(int percent) : percent_(std::max(1, percent)) {}
+
+	std::string name() const override {
+		return "resize";
+	}
+
+	void process(const cv::Mat& input, cv::Mat& output, EffectContext&) override {
+		const cv::Size size(std::max(1, input.cols * percent_ / 100), std::max(1, input.rows * percent_ / 100));
+		cv::resize(input, output, size, 0, 0, percent_ < 100 ? cv::INTER_AREA : cv::INTER_LINEAR);
+	}
+};
+
+// Реестр этапов: имя -> фабрика. Параметр этапа из записи "имя:число" (-1 - значение по умолчанию)
+class EffectRegistry {
+public:
+	using Factory = std::function<std::unique_ptr<EffectStage>(int param)>;
+
+private:
+	std::map<std::string, Factory> factories_;
+
+public:
+	void add(const std::string& name, Factory factory) {
+		factories_[name] = factory;
+	}
+
+	// nullptr - имя не зарегистрировано
+	std::unique_ptr<EffectStage> create(const std::string& name, int param) const {
+		auto it = factories_.find(name);
+		if (it == factories_.end()) {
+			return nullptr;
+		}
+		return it->second(param);
+	}
+
+	std::vector<std::string> names() const {
+		std::vector<std::string> result;
+		for (const auto& entry : factories_) {
+			result.push_back(entry.first);
+		}
+		return result;
+	}
+};
+
+// Цепочка этапов с замером времени каждого этапа
+class EffectChain {
+private:
+	struct Entry {
+		std::unique_ptr<EffectStage> stage;
+		double total_ms = 0.0;  // Суммарное время этапа
+		uint64_t calls = 0;  // Число вызовов
+	};
+
+	std::vector<Entry> stages_;
+	cv::Mat buffers_[2];  // Промежуточные кадры между этапами (по очереди)
+	EffectContext context_;
+
+public:
+	// Сборка по списку "имя" или "имя:параметр"; неизвестное имя - std::invalid_argument
+	void build(const std::vector<std::string>& spec, const EffectRegistry& registry) {
+		std::vector<Entry> stages;
+		for (const std::string& item : spec) {
+			const size_t colon = item.find(':');
+			const std::string name = item.substr(0, colon);
+			const int param = colon == std::string::npos ? -1 : std::stoi(item.substr(colon + 1));
+			Entry entry;
+			entry.stage = registry.create(name, param);
+			if (!entry.stage) {
+				throw std::invalid_argument("Unknown effect stage: " + name);
+			}
+			stages.push_back(std::move(entry));
+		}
+		if (stages.empty()) {
+			throw std::invalid_argument("Effect chain is empty");
+		}
+		stages_ = std::move(stages);
+	}
+
+	bool empty() const {
+		return stages_.empty();
+	}
+
+	// Цепочка из одного этапа name (например, только полный эффект scanner_darkly)
+	bool isSingle(const std::string& name) const {
+		return stages_.size() == 1 && stages_[0].stage->name() == name;
+	}
+
+	// Прогон кадра через все этапы: последний изменяющий изображение этап пишет сразу в output
+	void process(const cv::Mat& input, cv::Mat& output) {
+		int last_transform = -1;
+		for (size_t i = 0; i < stages_.size(); i++) {
+			if (stages_[i].stage->transformsImage()) {
+				last_transform = static_cast<int>(i);
+			}
+		}
+
+		context_.edges.release();  // Контуры прошлого кадра не переходят в новый
+		const cv::Mat* current = &input;
+		int next_buffer = 0;
+		for (size_t i = 0; i < stages_.size(); i++) {
+			Entry& entry = stages_[i];
+			cv::Mat* target = nullptr;
+			if (entry.stage->transformsImage()) {
+				target = (static_cast<int>(i) == last_transform) ? &output : &buffers_[next_buffer];
+			}
+			cv::Mat unused;
+			auto start = std::chrono::steady_clock::now();
+			entry.stage->process(*current, target ? *target : unused, context_);
+			auto end = std::chrono::steady_clock::now();
+			entry.total_ms += std::chrono::duration<double, std::milli>(end - start).count();
+			entry.calls++;
+			if (target) {
+				current = target;
+				next_buffer = 1 - next_buffer;
+			}
+		}
+		if (last_transform < 0) {
+			input.copyTo(output);  // Только анализирующие этапы - кадр без изменений
+		}
+	}
+
+	// Среднее время этапов: "имя avg ms"
+	void printStats(std::ostream& out, const std::string& prefix) const {
+		for (const Entry& entry : stages_) {
+			out << prefix << entry.stage->name() << ": "
+				<< (entry.calls ? entry.total_ms / entry.calls : 0.0) << " ms avg" << std::endl;
+		}
+	}
+};
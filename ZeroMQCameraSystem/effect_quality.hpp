@@ -0,0 +1,64 @@
+﻿#pragma once
+#include <opencv2/opencv.hpp>
+
+// Метрики качества результата эффекта относительно эталона (регрессия быстрых путей в 4_Benchmark)
+namespace effect_quality {
+
+	// PSNR в дБ (для совпадающих изображений OpenCV возвращает ~361)
+	inline double psnr(const cv::Mat& result, const cv::Mat& reference) {
+		return cv::PSNR(result, reference);
+	}
+
+	// SSIM (гауссово окно 11x11, sigma 1.5, константы для 8 бит), среднее по каналам
+	inline double ssim(const cv::Mat& result, const cv::Mat& reference) {
+		const double c1 = 6.5025;  // (0.01 * 255)^2
+		const double c2 = 58.5225;  // (0.03 * 255)^2
+		const cv::Size window(11, 11);
+		cv::Mat i1, i2;
+		result.convertTo(i1, CV_32F);
+		reference.convertTo(i2, CV_32F);
+
+		cv::Mat mu1, mu2;  // Локальные средние
+		cv::GaussianBlur(i1, mu1, window, 1.5);
+		cv::GaussianBlur(i2, mu2, window, 1.5);
+		cv::Mat mu1_sq = mu1.mul(mu1);
+		cv::Mat mu2_sq = mu2.mul(mu2);
+		cv::Mat mu1_mu2 = mu1.mul(mu2);
+
+		cv::Mat sigma1_sq, sigma2_sq, sigma12;  // Локальные дисперсии и ковариация
+		cv::GaussianBlur(i1.mul(i1), sigma1_sq, window, 1.5);
+		sigma1_sq -= mu1_sq;
+		cv::GaussianBlur(i2.mul(i2), sigma2_sq, window, 1.5);
+		sigma2_sq -= mu2_sq;
+		cv::GaussianBlur(i1.mul(i2), sigma12, window, 1.5);
+		sigma12 -= mu1_mu2;
+
+		cv::Mat numerator = (2 * mu1_mu2 + c1).mul(2 * sigma12 + c2);
+		cv::Mat denominator = (mu1_sq + mu2_sq + c1).mul(sigma1_sq + sigma2_sq + c2);
+		cv::Mat ssim_map;
+		cv::divide(numerator, denominator, ssim_map);
+		const cv::Scalar channel_mean = cv::mean(ssim_map);
+		double sum = 0.0;
+		for (int c = 0; c < result.channels(); c++) {
+			sum += channel_mean[c];
+		}
+		return sum / result.channels();
+	}
+
+	// Маска контуров результата: пиксели цвета контура (0 - черные, 255 - белые)
+	inline cv::Mat contourMask(const cv::Mat& result, uchar contour) {
+		cv::Mat mask;
+		cv::inRange(result, cv::Scalar(contour, contour, contour), cv::Scalar(contour, contour, contour), mask);
+		return mask;
+	}
+
+	// IoU масок контуров: пересечение / объединение (1 - обе маски пусты)
+	inline double edgeIoU(const cv::Mat& mask, const cv::Mat& reference_mask) {
+		cv::Mat intersection, united;
+		cv::bitwise_and(mask, reference_mask, intersection);
+		cv::bitwise_or(mask, reference_mask, united);
+		const int union_count = cv::countNonZero(united);
+		return union_count == 0 ? 1.0 : static_cast<double>(cv::countNonZero(intersection)) / union_count;
+	}
+
+}
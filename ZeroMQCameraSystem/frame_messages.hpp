@@ -0,0 +1,157 @@
+﻿#pragma once
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <cstring>
+#include "video_processing.pb.h"
+#include "palette_codec.hpp"
+
+// Сборка и разбор сообщений кадра без лишних копий закодированного изображения.
+// Сообщения переиспользуются между кадрами: строки и вложенные сообщения сохраняют выделенную память.
+// Внутри компонентов кадр - BGR (CV_8UC3) или серый (CV_8UC1); pixel_format и encoding сообщения
+// учитываются только здесь, при кодировании и декодировании
+namespace frame_messages {
+
+	// Каналов в пикселе формата: GRAY - 1, RGB и BGR - 3
+	inline int channelsOf(video_processing::PixelFormat pixel_format) {
+		return pixel_format == video_processing::GRAY ? 1 : 3;
+	}
+
+	// Буферы кодирования (переиспользуются между кадрами)
+	struct EncodeBuffers {
+		std::vector<uchar> encoded;  // Результат cv::imencode
+		cv::Mat converted;  // Кадр в pixel_format сообщения, если он отличается от кадра компонента
+	};
+
+	// Закодированные байты как cv::Mat поверх строки сообщения (для cv::imdecode без копии в std::vector)
+	inline cv::Mat encodedBytes(const std::string& data) {
+		return cv::Mat(1, static_cast<int>(data.size()), CV_8U, const_cast<char*>(data.data()));
+	}
+
+	// Кадр компонента (BGR или серый) в pixel_format: без копии, если формат уже совпадает
+	inline const cv::Mat& toPixelFormat(const cv::Mat& image, video_processing::PixelFormat pixel_format, cv::Mat& converted) {
+		if (pixel_format == video_processing::GRAY) {
+			if (image.channels() == 1) {
+				return image;
+			}
+			cv::cvtColor(image, converted, cv::COLOR_BGR2GRAY);
+			return converted;
+		}
+		if (image.channels() == 1) {
+			cv::cvtColor(image, converted, pixel_format == video_processing::RGB ? cv::COLOR_GRAY2RGB : cv::COLOR_GRAY2BGR);
+			return converted;
+		}
+		if (pixel_format == video_processing::RGB) {
+			cv::cvtColor(image, converted, cv::COLOR_BGR2RGB);
+			return converted;
+		}
+		return image;
+	}
+
+	// Кодирование кадра прямо в поля ImageData: строка image_data переписывается на месте и сохраняет
+	// емкость между кадрами. jpeg_params - параметры JPEG (качество). RAW - одно копирование строк кадра
+	// в сообщение. PALETTE_RLE при числе цветов больше palette_codec::max_colors заменяется на JPEG
+	// (фактическое кодирование - в поле encoding)
+	inline void encodeImageData(const cv::Mat& image, const std::vector<int>& jpeg_params,
+		video_processing::PixelFormat pixel_format, video_processing::ImageEncoding encoding,
+		EncodeBuffers& buffers, video_processing::ImageData* image_data) {
+		const cv::Mat& pixels = toPixelFormat(image, pixel_format, buffers.converted);
+		image_data->set_width(pixels.cols);
+		image_data->set_height(pixels.rows);
+		image_data->set_pixel_format(pixel_format);
+		std::string* data = image_data->mutable_image_data();
+
+		if (encoding == video_processing::PALETTE_RLE && palette_codec::encode(pixels, *data)) {
+			image_data->set_encoding(video_processing::PALETTE_RLE);
+			return;
+		}
+		if (encoding == video_processing::RAW) {
+			const size_t row_bytes = pixels.cols * pixels.elemSize();
+			data->resize(row_bytes * pixels.rows);
+			for (int y = 0; y < pixels.rows; y++) {
+				memcpy(&(*data)[y * row_bytes], pixels.ptr(y), row_bytes);
+			}
+			image_data->set_encoding(video_processing::RAW);
+			return;
+		}
+
+		static const std::vector<int> png_params = { cv::IMWRITE_PNG_COMPRESSION, 1 };  // Быстрое сжатие: важнее время кадра
+		static const std::vector<int> no_params;
+		if (encoding == video_processing::PNG) {
+			cv::imencode(".png", pixels, buffers.encoded, png_params);
+		}
+		else if (encoding == video_processing::BMP) {
+			cv::imencode(".bmp", pixels, buffers.encoded, no_params);
+		}
+		else {
+			encoding = video_processing::JPEG;  // JPEG и замена PALETTE_RLE
+			cv::imencode(".jpg", pixels, buffers.encoded, jpeg_params);
+		}
+		image_data->set_encoding(encoding);
+		data->assign(reinterpret_cast<const char*>(buffers.encoded.data()), buffers.encoded.size());
+	}
+
+	// Декодирование ImageData в кадр компонента: BGR (CV_8UC3) или серый (CV_8UC1) для GRAY.
+	// scale 2 / 4 - уменьшенный кадр (JPEG - масштабирование в IDCT, остальные - INTER_AREA, размер с округлением вверх).
+	// color - серый кадр тоже переводится в BGR (например, для cv::VideoWriter).
+	// output всегда владеет данными. false - данные повреждены или не совпадают с размером
+	inline bool decodeImageData(const video_processing::ImageData& image_data, int scale, bool color, cv::Mat& output) {
+		const std::string& data = image_data.image_data();
+		const int channels = channelsOf(image_data.pixel_format());
+		const int width = static_cast<int>(image_data.width());
+		const int height = static_cast<int>(image_data.height());
+		cv::Mat pixels;
+		bool owned = true;  // pixels не ссылается на байты сообщения
+		bool reduced = scale <= 1;  // Уменьшение уже выполнено декодером
+		switch (image_data.encoding()) {
+		case video_processing::RAW:
+			if (width <= 0 || height <= 0 || data.size() != static_cast<size_t>(width) * height * channels) {
+				return false;
+			}
+			pixels = cv::Mat(height, width, CV_8UC(channels), const_cast<char*>(data.data()));  // Без копии
+			owned = false;
+			break;
+		case video_processing::PALETTE_RLE:
+			if (!palette_codec::decode(data, width, height, channels, pixels)) {
+				return false;
+			}
+			break;
+		default: {  // JPEG, PNG, BMP
+			int flags = channels == 1 ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+			if (image_data.encoding() == video_processing::JPEG && (scale == 2 || scale == 4)) {
+				if (scale == 2) {
+					flags = channels == 1 ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2;
+				}
+				else {
+					flags = channels == 1 ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4;
+				}
+				reduced = true;
+			}
+			pixels = cv::imdecode(encodedBytes(data), flags);
+			if (pixels.empty()) {
+				return false;
+			}
+		}
+		}
+
+		cv::Mat converted;
+		if (!reduced) {
+			cv::resize(pixels, converted, cv::Size((pixels.cols + scale - 1) / scale, (pixels.rows + scale - 1) / scale),
+				0, 0, cv::INTER_AREA);
+			pixels = converted;
+			owned = true;
+		}
+		if (image_data.pixel_format() == video_processing::RGB) {
+			cv::cvtColor(pixels, converted, cv::COLOR_RGB2BGR);
+			pixels = converted;
+			owned = true;
+		}
+		else if (color && pixels.channels() == 1) {
+			cv::cvtColor(pixels, converted, cv::COLOR_GRAY2BGR);
+			pixels = converted;
+			owned = true;
+		}
+		output = owned ? pixels : pixels.clone();
+		return true;
+	}
+}
@@ -0,0 +1,149 @@
+﻿#pragma once
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include "scanner_darkly_effect.hpp"
+
+// Инкрементальная обработка для неподвижных камер: эффект пересчитывается только в плитках,
+// изменившихся с момента их последнего пересчета, и вклеивается в предыдущий результат потока
+class IncrementalEffect {
+private:
+	// Состояние одного потока (по sender_id кадра)
+	struct StreamState {
+		cv::Mat reference;  // Вход, по которому посчитана каждая плитка output
+		cv::Mat output;  // Последний результат эффекта
+		std::vector<cv::Vec3b> palette;  // Палитра последнего полного кадра потока
+		int frames_since_refresh = 0;  // Кадров после последнего полного пересчета
+		std::chrono::steady_clock::time_point last_frame;  // Время последнего кадра потока
+	};
+
+	ScannerDarklyEffect& effect_;  // Эффект Worker'а (настройки и буферы общие)
+	int tile_size_ = 64;  // Сторона плитки в пикселях
+	int threshold_ = 6;  // Порог средней абсолютной разности на канал (0-255)
+	int refresh_interval_ = 30;  // Полный пересчет (и новая палитра) каждые N кадров, 0 - только при смене размера
+	int full_frame_percent_ = 50;  // При большей доле измененных плиток - полный пересчет
+	int idle_timeout_ms_ = 10000;  // Состояние потока без кадров дольше - удаляется, 0 - не удаляется
+	std::map<std::string, StreamState> streams_;  // Состояния потоков
+	std::vector<uchar> dirty_;  // Флаги плиток текущего кадра
+
+public:
+	explicit IncrementalEffect(ScannerDarklyEffect& effect) : effect_(effect) {}
+
+	void setTileSize(int size) {
+		tile_size_ = std::max(8, size);
+	}
+
+	void setThreshold(int threshold) {
+		threshold_ = std::max(0, threshold);
+	}
+
+	void setRefreshInterval(int frames) {
+		refresh_interval_ = std::max(0, frames);
+	}
+
+	void setIdleTimeout(int milliseconds) {
+		idle_timeout_ms_ = std::max(0, milliseconds);
+	}
+
+	size_t streamCount() const {
+		return streams_.size();
+	}
+
+	// Эффект для кадра потока stream_id; в output копируется результат потока (буфер вызывающего,
+	// состояние потока от записи в него не меняется). Возвращает долю пересчитанных плиток (0..1)
+	double apply(const std::string& stream_id, const cv::Mat& input_frame, cv::Mat& output) {
+		if (input_frame.empty()) {
+			throw std::invalid_argument("Input frame is empty");
+		}
+		const auto now = std::chrono::steady_clock::now();
+		evictIdle(now, stream_id);  // Перезапущенный Capturer приходит с новым sender_id: старое состояние не нужно
+		StreamState& state = streams_[stream_id];
+		state.last_frame = now;
+		const bool refresh_due = refresh_interval_ > 0 && state.frames_since_refresh >= refresh_interval_;
+		if (state.output.size() != input_frame.size() || state.output.type() != input_frame.type() || refresh_due) {
+			return applyFull(state, input_frame, output);  // Первый кадр потока, смена размера или плановое обновление
+		}
+
+		// Метрика плитки: средняя абсолютная разность с входом, по которому плитка посчитана
+		const int tiles_x = (input_frame.cols + tile_size_ - 1) / tile_size_;
+		const int tiles_y = (input_frame.rows + tile_size_ - 1) / tile_size_;
+		dirty_.assign(static_cast<size_t>(tiles_x) * tiles_y, 0);
+		int dirty_count = 0;
+		for (int ty = 0; ty < tiles_y; ty++) {
+			for (int tx = 0; tx < tiles_x; tx++) {
+				const cv::Rect tile = tileRect(input_frame.size(), tx, ty);
+				const double mean_diff = cv::norm(input_frame(tile), state.reference(tile), cv::NORM_L1)
+					/ (static_cast<double>(tile.area()) * input_frame.channels());
+				if (mean_diff > threshold_) {
+					dirty_[static_cast<size_t>(ty) * tiles_x + tx] = 1;
+					dirty_count++;
+				}
+			}
+		}
+		if (dirty_count * 100 > static_cast<int>(dirty_.size()) * full_frame_percent_) {
+			return applyFull(state, input_frame, output);  // Изменилась большая часть кадра
+		}
+
+		// Пересчет измененных плиток с палитрой потока; соседние плитки ряда объединяются в одну область
+		if (dirty_count > 0) {
+			effect_.usePalette(state.palette);
+		}
+		for (int ty = 0; ty < tiles_y; ty++) {
+			for (int tx = 0; tx < tiles_x; tx++) {
+				if (!dirty_[static_cast<size_t>(ty) * tiles_x + tx]) {
+					continue;
+				}
+				int run_end = tx + 1;
+				while (run_end < tiles_x && dirty_[static_cast<size_t>(ty) * tiles_x + run_end]) {
+					run_end++;
+				}
+				const cv::Rect region = tileRect(input_frame.size(), tx, ty) | tileRect(input_frame.size(), run_end - 1, ty);
+				effect_.applyEffectRegion(input_frame, region, state.output);
+				input_frame(region).copyTo(state.reference(region));
+				tx = run_end - 1;
+			}
+		}
+		state.frames_since_refresh++;
+		state.output.copyTo(output);
+		return static_cast<double>(dirty_count) / dirty_.size();
+	}
+
+	// Забыть состояние потока (поток завершился)
+	void resetStream(const std::string& stream_id) {
+		streams_.erase(stream_id);
+	}
+
+private:
+	// Полный пересчет кадра с обучением новой палитры
+	double applyFull(StreamState& state, const cv::Mat& input_frame, cv::Mat& output) {
+		effect_.applyEffect(input_frame, state.output);
+		input_frame.copyTo(state.reference);
+		state.palette = effect_.palette();
+		state.frames_since_refresh = 0;
+		state.output.copyTo(output);
+		return 1.0;
+	}
+
+	// Удаление состояний потоков, не присылавших кадров дольше idle_timeout_ms_ (кроме текущего)
+	void evictIdle(std::chrono::steady_clock::time_point now, const std::string& current_id) {
+		if (idle_timeout_ms_ <= 0) {
+			return;
+		}
+		const auto timeout = std::chrono::milliseconds(idle_timeout_ms_);
+		for (auto it = streams_.begin(); it != streams_.end();) {
+			if (it->first != current_id && now - it->second.last_frame > timeout) {
+				it = streams_.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
+	// Прямоугольник плитки (tx, ty) с обрезкой по границе кадра
+	cv::Rect tileRect(cv::Size size, int tx, int ty) const {
+		return cv::Rect(tx * tile_size_, ty * tile_size_, tile_size_, tile_size_) & cv::Rect(0, 0, size.width, size.height);
+	}
+};
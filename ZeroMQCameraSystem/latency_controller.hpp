@@ -0,0 +1,95 @@
+﻿#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// Регулятор задержки Worker'а: по среднему времени эффекта за окно кадров спускается по лестнице
+// все более дешевых настроек, пока кадр не уложится в бюджет, и поднимается обратно при запасе времени
+class LatencyController {
+public:
+	// Ступень лестницы настроек
+	struct Tier {
+		int kmeans_iterations;  // Максимум итераций k-means
+		int kmeans_attempts;    // Попытки k-means
+		int sample_percent;     // Верхняя граница доли пикселей для обучения k-means (%)
+		int scale_tier;         // Нижняя граница уровня масштаба Worker'а: 0 - полный кадр, 1 - 1/2, 2 - 1/4
+	};
+
+private:
+	std::vector<Tier> ladder_;  // Ступень 0 - полные настройки, дальше - дешевле
+	double budget_ms_;  // Бюджет времени эффекта на кадр (0 - регулятор выключен)
+	int window_;  // Кадров в окне усреднения
+	double relax_ratio_ = 0.5;  // Подъем на ступень дороже, только если среднее меньше budget * relax_ratio
+	int tier_ = 0;  // Текущая ступень
+	double window_sum_ms_ = 0.0;  // Сумма времени кадров текущего окна
+	int window_frames_ = 0;  // Кадров в текущем окне
+	double last_average_ms_ = 0.0;  // Среднее за последнее завершенное окно
+	uint64_t tier_changes_ = 0;  // Число переходов между ступенями
+
+public:
+	LatencyController(double budget_ms, int window)
+		: budget_ms_(std::max(0.0, budget_ms)), window_(std::max(1, window)) {
+		ladder_ = {
+			{ 10, 3, 100, 0 },  // Полные настройки (как без регулятора)
+			{ 10, 1, 100, 0 },  // Одна попытка k-means
+			{ 5, 1, 100, 0 },   // Меньше итераций
+			{ 5, 1, 25, 0 },    // Обучение на 25% пикселей
+			{ 5, 1, 10, 0 },    // Обучение на 10% пикселей
+			{ 5, 1, 10, 1 },    // Кадр 1/2
+			{ 5, 1, 10, 2 },    // Кадр 1/4
+		};
+	}
+
+	bool enabled() const {
+		return budget_ms_ > 0.0;
+	}
+
+	int tier() const {
+		return tier_;
+	}
+
+	const Tier& settings() const {
+		return ladder_[tier_];
+	}
+
+	double budgetMs() const {
+		return budget_ms_;
+	}
+
+	double lastAverageMs() const {
+		return last_average_ms_;
+	}
+
+	uint64_t tierChanges() const {
+		return tier_changes_;
+	}
+
+	// Учет времени эффекта очередного кадра. true - ступень сменилась, настройки нужно применить
+	bool update(double frame_ms) {
+		if (!enabled()) {
+			return false;
+		}
+		window_sum_ms_ += frame_ms;
+		window_frames_++;
+		if (window_frames_ < window_) {
+			return false;
+		}
+		last_average_ms_ = window_sum_ms_ / window_frames_;
+		window_sum_ms_ = 0.0;
+		window_frames_ = 0;
+
+		int next = tier_;
+		if (last_average_ms_ > budget_ms_ && tier_ + 1 < static_cast<int>(ladder_.size())) {
+			next = tier_ + 1;  // Не укладываемся - дешевле
+		}
+		else if (last_average_ms_ < budget_ms_ * relax_ratio_ && tier_ > 0) {
+			next = tier_ - 1;  // Большой запас - дороже (зазор между порогами против колебаний)
+		}
+		if (next == tier_) {
+			return false;
+		}
+		tier_ = next;
+		tier_changes_++;
+		return true;
+	}
+};
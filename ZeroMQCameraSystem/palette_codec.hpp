@@ -0,0 +1,134 @@
+﻿#pragma once
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+// Кодек PALETTE_RLE для обработанных кадров: палитра (до 255 цветов) и серии индексов.
+// Результат эффекта - несколько плоских цветов и контуры, поэтому серии длинные, а кодирование без потерь.
+// Формат: N (1 байт), N цветов (по 3 байта для BGR/RGB, по 1 байту для GRAY), затем пары
+// "индекс (1 байт), длина серии (varint)" по строкам подряд. Число каналов - из pixel_format сообщения
+namespace palette_codec {
+
+	const int max_colors = 255;
+
+	// Длина серии: 7 бит на байт, старший бит - продолжение
+	inline void writeVarint(std::string& out, uint32_t value) {
+		while (value >= 0x80) {
+			out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<char>(value));
+	}
+
+	inline bool readVarint(const uchar*& pos, const uchar* end, uint32_t& value) {
+		value = 0;
+		for (int shift = 0; shift < 35 && pos < end; shift += 7) {
+			const uchar byte = *pos++;
+			value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Кодирование кадра CV_8UC3 или CV_8UC1 в out (строка переписывается, емкость сохраняется).
+	// false - больше max_colors цветов: кадр нужно кодировать иначе (JPEG)
+	inline bool encode(const cv::Mat& image, std::string& out) {
+		CV_Assert(image.type() == CV_8UC3 || image.type() == CV_8UC1);
+		const int channels = image.channels();
+		uint32_t palette[max_colors];  // Цвета как 0x00RRGGBB (серый - 0x000000VV)
+		int colors = 0;
+		out.assign(1 + max_colors * channels, '\0');  // Место под N и наибольшую палитру: лишнее удаляется после подсчета цветов
+
+		int run_index = -1;
+		uint32_t run_length = 0;
+		int last_index = 0;
+		uint32_t last_color = 0xFFFFFFFF;  // Последний найденный цвет: соседние пиксели почти всегда совпадают
+		for (int y = 0; y < image.rows; y++) {
+			const uchar* row = image.ptr<uchar>(y);
+			for (int x = 0; x < image.cols; x++, row += channels) {
+				const uint32_t color = channels == 3 ? (row[0] | (row[1] << 8) | (row[2] << 16)) : row[0];
+				if (color != last_color) {
+					int index = 0;
+					while (index < colors && palette[index] != color) {
+						index++;
+					}
+					if (index == colors) {
+						if (colors == max_colors) {
+							return false;
+						}
+						palette[colors++] = color;
+					}
+					last_color = color;
+					last_index = index;
+				}
+				if (last_index == run_index) {
+					run_length++;
+					continue;
+				}
+				if (run_length > 0) {
+					out.push_back(static_cast<char>(run_index));
+					writeVarint(out, run_length);
+				}
+				run_index = last_index;
+				run_length = 1;
+			}
+		}
+		if (run_length > 0) {
+			out.push_back(static_cast<char>(run_index));
+			writeVarint(out, run_length);
+		}
+
+		out[0] = static_cast<char>(colors);
+		for (int i = 0; i < colors; i++) {
+			for (int c = 0; c < channels; c++) {
+				out[1 + i * channels + c] = static_cast<char>((palette[i] >> (8 * c)) & 0xFF);
+			}
+		}
+		out.erase(1 + colors * channels, (max_colors - colors) * channels);  // Серии сдвигаются к палитре
+		return true;
+	}
+
+	// Декодирование в кадр width x height с channels каналами (1 или 3; буфер output переиспользуется).
+	// false - данные повреждены
+	inline bool decode(const std::string& data, int width, int height, int channels, cv::Mat& output) {
+		if (data.empty() || width <= 0 || height <= 0 || (channels != 1 && channels != 3)) {
+			return false;
+		}
+		const uchar* pos = reinterpret_cast<const uchar*>(data.data());
+		const uchar* end = pos + data.size();
+		const int colors = *pos++;
+		if (colors == 0 || end - pos < colors * channels) {
+			return false;
+		}
+		const uchar* palette = pos;
+		pos += colors * channels;
+
+		output.create(height, width, CV_8UC(channels));
+		CV_Assert(output.isContinuous());
+		uchar* pixel = output.ptr<uchar>();
+		uchar* const pixels_end = pixel + output.total() * channels;
+		while (pos < end) {
+			const int index = *pos++;
+			uint32_t length = 0;
+			if (index >= colors || !readVarint(pos, end, length)
+				|| length > static_cast<size_t>(pixels_end - pixel) / channels) {
+				return false;
+			}
+			const uchar* color = palette + index * channels;
+			if (channels == 1) {
+				memset(pixel, color[0], length);
+				pixel += length;
+				continue;
+			}
+			for (uint32_t i = 0; i < length; i++, pixel += 3) {
+				pixel[0] = color[0];
+				pixel[1] = color[1];
+				pixel[2] = color[2];
+			}
+		}
+		return pixel == pixels_end;
+	}
+}
@@ -0,0 +1,185 @@
+﻿#pragma once
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <bitset>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+// Кэш результатов Worker'а для неподвижных сцен: ключ - быстрый хеш байтов входного кадра,
+// при промахе - поиск похожего кадра по перцептивному хешу (dHash). Значение - закодированный
+// обработанный кадр. Размер ограничен числом записей, вытесняется давно не использованная (LRU)
+class ResultCache {
+public:
+	// Закодированный обработанный кадр
+	struct Result {
+		std::string data;
+		int width = 0;
+		int height = 0;
+		int encoding = 0;  // video_processing::ImageEncoding (worker_processed_encoding или JPEG)
+		int pixel_format = 0;  // video_processing::PixelFormat (как у входного кадра)
+	};
+
+private:
+	struct Entry {
+		uint64_t key;  // Хеш байтов входа (с учетом варианта настроек)
+		uint64_t variant;  // Вариант настроек эффекта, с которыми посчитан результат
+		uint64_t phash;  // dHash входа (0 - не посчитан)
+		Result result;
+	};
+
+	size_t capacity_;  // Максимум записей (0 - кэш выключен)
+	int phash_distance_;  // Максимальное расстояние Хэмминга dHash (-1 - только точное совпадение)
+	std::list<Entry> entries_;  // В начале - недавно использованные
+	std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;  // Ключ -> запись
+	uint64_t exact_hits_ = 0;  // Совпадения по байтам
+	uint64_t perceptual_hits_ = 0;  // Совпадения по dHash
+	uint64_t misses_ = 0;
+	uint64_t evictions_ = 0;
+	cv::Mat thumbnail_;  // Буфер уменьшенного серого кадра для dHash
+
+public:
+	ResultCache(int capacity, int phash_distance)
+		: capacity_(static_cast<size_t>(std::max(0, capacity))), phash_distance_(std::min(phash_distance, 64)) {}
+
+	bool enabled() const {
+		return capacity_ > 0;
+	}
+
+	bool perceptual() const {
+		return enabled() && phash_distance_ >= 0;
+	}
+
+	// 64-битный хеш байтов: слова по 8 байт с умножением и перемешиванием, финал как в MurmurHash3
+	static uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+		const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+		const uchar* bytes = static_cast<const uchar*>(data);
+		uint64_t h = seed ^ (size * multiplier);
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			uint64_t word;
+			memcpy(&word, bytes + i, 8);  // Без требований к выравниванию
+			h = (h ^ word) * multiplier;
+			h ^= h >> 29;
+		}
+		uint64_t tail = 0;
+		for (size_t shift = 0; i < size; i++, shift += 8) {
+			tail |= static_cast<uint64_t>(bytes[i]) << shift;
+		}
+		h = (h ^ tail) * multiplier;
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDull;
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	// dHash: JPEG декодируется в 1/8 серым, уменьшается до 9x8, бит - яркость растет вправо.
+	// 0 - не удалось декодировать (например, RAW): такие кадры ищутся только по точному совпадению
+	uint64_t perceptualHash(const std::string& encoded) {
+		cv::Mat reduced = cv::imdecode(cv::Mat(1, static_cast<int>(encoded.size()), CV_8U, const_cast<char*>(encoded.data())),
+			cv::IMREAD_REDUCED_GRAYSCALE_8);
+		if (reduced.empty()) {
+			return 0;
+		}
+		cv::resize(reduced, thumbnail_, cv::Size(9, 8), 0, 0, cv::INTER_AREA);
+		uint64_t hash = 0;
+		for (int y = 0; y < 8; y++) {
+			const uchar* row = thumbnail_.ptr<uchar>(y);
+			for (int x = 0; x < 8; x++) {
+				hash = (hash << 1) | (row[x + 1] > row[x] ? 1u : 0u);
+			}
+		}
+		return hash | 1;  // Младший бит всегда 1: хеш не совпадает с признаком "не посчитан"
+	}
+
+	// Поиск результата: сначала точный по key, при промахе (если включен) - ближайший по dHash с тем же вариантом.
+	// phash - dHash входа для последующего insert (0 - не считался). nullptr - промах.
+	// Указатель действителен до следующего insert
+	const Result* find(uint64_t key, uint64_t variant, const std::string& encoded, uint64_t& phash) {
+		phash = 0;
+		auto it = index_.find(key);
+		if (it != index_.end()) {
+			entries_.splice(entries_.begin(), entries_, it->second);  // В начало списка LRU
+			exact_hits_++;
+			return &entries_.front().result;
+		}
+		if (perceptual()) {
+			phash = perceptualHash(encoded);  // Декодирование в 1/8 - только при промахе по байтам
+		}
+		if (phash != 0) {
+			auto best = entries_.end();
+			int best_distance = phash_distance_ + 1;
+			for (auto entry = entries_.begin(); entry != entries_.end(); ++entry) {
+				if (entry->phash == 0 || entry->variant != variant) {
+					continue;
+				}
+				const int distance = static_cast<int>(std::bitset<64>(entry->phash ^ phash).count());
+				if (distance < best_distance) {
+					best_distance = distance;
+					best = entry;
+				}
+			}
+			if (best != entries_.end()) {
+				entries_.splice(entries_.begin(), entries_, best);
+				perceptual_hits_++;
+				return &entries_.front().result;
+			}
+		}
+		misses_++;
+		return nullptr;
+	}
+
+	// Сохранение результата; при переполнении вытесняется последняя запись списка LRU
+	void insert(uint64_t key, uint64_t variant, uint64_t phash, Result result) {
+		if (!enabled()) {
+			return;
+		}
+		auto it = index_.find(key);
+		if (it != index_.end()) {
+			entries_.erase(it->second);
+			index_.erase(it);
+		}
+		while (entries_.size() >= capacity_) {
+			index_.erase(entries_.back().key);
+			entries_.pop_back();
+			evictions_++;
+		}
+		Entry entry;
+		entry.key = key;
+		entry.variant = variant;
+		entry.phash = phash;
+		entry.result = std::move(result);
+		entries_.push_front(std::move(entry));
+		index_[key] = entries_.begin();
+	}
+
+	uint64_t exactHits() const {
+		return exact_hits_;
+	}
+
+	uint64_t perceptualHits() const {
+		return perceptual_hits_;
+	}
+
+	uint64_t misses() const {
+		return misses_;
+	}
+
+	uint64_t evictions() const {
+		return evictions_;
+	}
+
+	// "записей/емкость, попадания (точные + по dHash), промахи, вытеснения, доля попаданий"
+	void printStats(std::ostream& out, const std::string& prefix) const {
+		const uint64_t hits = exact_hits_ + perceptual_hits_;
+		const uint64_t lookups = hits + misses_;
+		out << prefix << entries_.size() << "/" << capacity_ << " entries, " << hits << " hits ("
+			<< exact_hits_ << " exact, " << perceptual_hits_ << " perceptual), " << misses_ << " misses, "
+			<< evictions_ << " evicted, hit rate " << (lookups ? hits * 100.0 / lookups : 0.0) << "%" << std::endl;
+	}
+};
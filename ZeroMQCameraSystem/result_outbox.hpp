@@ -0,0 +1,94 @@
+﻿#pragma once
+#include <zmq.hpp>
+#include <deque>
+#include <algorithm>
+#include <cstdint>
+
+// Outbox результатов Worker'а: сообщения, которые PUSH сокет не принял без блокировки (очередь Composer'а
+// заполнена), ждут здесь и уходят по POLLOUT. Порядок сообщений сохраняется, емкость ограничена
+class ResultOutbox {
+public:
+	enum class SendResult {
+		Sent,  // Принято сокетом сразу
+		Queued,  // Ждет в outbox
+		Dropped  // Outbox полон - сообщение потеряно
+	};
+
+private:
+	std::deque<zmq::message_t> queue_;
+	size_t capacity_;  // Максимум сообщений (не меньше 1)
+	uint64_t queued_ = 0;  // Сообщений, прошедших через outbox
+	uint64_t dropped_ = 0;  // Сообщений, потерянных при полном outbox
+	size_t max_depth_ = 0;  // Наибольшая глубина
+
+public:
+	explicit ResultOutbox(int capacity)
+		: capacity_(static_cast<size_t>(std::max(1, capacity))) {}
+
+	size_t size() const {
+		return queue_.size();
+	}
+
+	size_t capacity() const {
+		return capacity_;
+	}
+
+	bool empty() const {
+		return queue_.empty();
+	}
+
+	bool full() const {
+		return queue_.size() >= capacity_;
+	}
+
+	uint64_t queued() const {
+		return queued_;
+	}
+
+	uint64_t dropped() const {
+		return dropped_;
+	}
+
+	size_t maxDepth() const {
+		return max_depth_;
+	}
+
+	// События опроса PUSH сокета: POLLOUT - только пока в outbox есть что отправлять
+	short pollEvents() const {
+		return queue_.empty() ? 0 : ZMQ_POLLOUT;
+	}
+
+	// Отправка из outbox, пока сокет принимает без блокировки. Возвращает число отправленных
+	size_t flush(zmq::socket_t& socket) {
+		size_t sent = 0;
+		while (!queue_.empty() && socket.send(queue_.front(), ZMQ_DONTWAIT)) {
+			queue_.pop_front();
+			sent++;
+		}
+		return sent;
+	}
+
+	// Новое сообщение - после более ранних (порядок сохраняется): сразу в сокет, в outbox или сброс.
+	// Неудачная отправка сообщение не изменяет, поэтому в outbox оно переносится без копирования
+	SendResult send(zmq::socket_t& socket, zmq::message_t& message) {
+		flush(socket);
+		if (queue_.empty() && socket.send(message, ZMQ_DONTWAIT)) {
+			return SendResult::Sent;
+		}
+		if (full()) {
+			dropped_++;
+			return SendResult::Dropped;
+		}
+		queue_.push_back(std::move(message));
+		queued_++;
+		max_depth_ = std::max(max_depth_, queue_.size());
+		return SendResult::Queued;
+	}
+
+	// Сброс неотправленных сообщений. Возвращает их число
+	size_t clear() {
+		const size_t count = queue_.size();
+		queue_.clear();
+		return count;
+	}
+};
@@ -1,6 +1,11 @@
 ﻿#pragma once
 #include <opencv2/opencv.hpp>
 #include <vector>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include "effect_kernels.hpp"
 
 class ScannerDarklyEffect {
 private:
@@ -10,6 +15,41 @@ private:
 	int dilation_kernel_size_ = 1; // Размер ядра дилатации контуров  // Уменьшил для тонких контуров
 	int color_quantization_levels_ = 8; // Количество уровней квантования цвета
 	bool black_contours_ = true;  // Флаг для черных контуров
+	int kmeans_sample_percent_ = 100; // Доля пикселей для обучения k-means (%), 100 = все пиксели
+	int kmeans_iterations_ = 10; // Максимум итераций k-means
+	int kmeans_attempts_ = 3; // Число попыток k-means (лучшая по компактности)
+	bool kmeans_random_sampling_ = false; // Случайная (true) или равномерная (false) подвыборка
+	std::vector<cv::Vec3f> kmeans_samples_; // Подвыборка пикселей для обучения k-means
+	bool palette_lut_enabled_ = false; // Назначение цветов через 3D LUT вместо перебора центров
+	bool simd_assign_enabled_ = true; // Целочисленное SIMD-ядро назначения (до 16 центров)
+	bool specialized_kernels_ = true; // Ядра назначения, специализированные под число уровней и цвет контуров
+	effect_kernels::AssignRowFn assign_row_ = effect_kernels::selectAssignRow(8, 0); // Выбранное ядро (для уровней 8, черные контуры)
+	int parallel_strips_ = 0; // Число горизонтальных полос для cv::parallel_for_ (0/1 - последовательно)
+	bool fused_output_enabled_ = true; // Квантование и наложение контуров за один проход по кадру
+	std::vector<int> kmeans_labels_; // Метки k-means обучающей выборки (при 100% - метки всех пикселей)
+	cv::Mat kmeans_centers_; // Центры k-means (уровни x 3, float)
+	bool integer_kmeans_ = false; // Целочисленный k-means по 8-битным BGR вместо cv::kmeans на CV_32F
+	std::vector<cv::Vec3b> kmeans_int_samples_; // Подвыборка пикселей для целочисленного k-means
+	std::vector<cv::Vec3f> frame_samples_; // Подвыборка одного кадра пакета (trainSharedPalette)
+	std::vector<cv::Vec3b> frame_int_samples_; // То же для целочисленного k-means и median cut
+	effect_kernels::KMeansIntBuffers kmeans_int_buffers_; // Метки, суммы и центры целочисленного k-means
+	bool median_cut_ = false; // Палитра median cut по гистограмме 5:5:5 вместо k-means (детерминированная)
+	effect_kernels::MedianCutBuffers median_cut_buffers_; // Гистограмма и коробки median cut
+	std::vector<cv::Vec3b> median_cut_palette_; // Палитра последнего median cut
+	cv::Mat region_gray_, region_blur_, region_edges_; // Буферы контуров области с ореолом (applyEffectRegion)
+	cv::Mat reduced_quantized_, upscaled_edges_; // Быстрый уровень: палитра в уменьшенном масштабе и увеличенные контуры
+	cv::Mat gray_, blur_, edges_; // Промежуточные буферы контуров (переиспользуются между кадрами)
+	effect_kernels::BitMask edge_bits_, dilated_bits_, dilation_scratch_; // Битовые маски для утолщения контуров
+	std::vector<cv::Mat> strip_gray_, strip_blur_; // Буферы полос с ореолом для параллельного пути
+	uint64_t scratch_reallocations_ = 0; // Сколько раз буферы пересоздавались (смена размера кадра)
+	std::vector<cv::Vec3f> center_colors_; // Центры кластеров текущей палитры (float)
+	std::vector<cv::Vec3b> palette_; // Цвета текущей палитры
+	std::vector<uchar> gray_levels_; // Уровни яркости серого кадра (одноканальный путь)
+	cv::Mat gray_lut_; // LUT 256: ближайший уровень для каждой яркости
+	std::vector<uchar> palette_lut_; // LUT 32x32x32: индекс ближайшего центра для ячейки BGR 5:5:5
+	std::vector<cv::Vec3f> lut_centers_; // Центры, по которым построена palette_lut_
+
+	static const int kLutBits = 5; // Бит на канал в индексе LUT
 
 public:
 	ScannerDarklyEffect() = default;  // Конструктор по умолчанию
@@ -24,22 +64,116 @@ public:
 		gaussian_kernel_size_ = size;
 	}
 
+	// Утолщение контуров квадратным ядром size x size (0/1 - тонкие контуры Кэнни)
 	void setDilationKernelSize(int size) {
 		dilation_kernel_size_ = size;
 	}
 
 	void setColorQuantizationLevels(int levels) {
 		color_quantization_levels_ = levels;
+		selectKernels();
 	}
 
 	void setBlackContours(bool black) {
 		black_contours_ = black;
+		selectKernels();
+	}
+
+	// Обучение k-means на подвыборке: percent - доля пикселей (1-100), random - случайная или равномерная сетка
+	void setKMeansSampling(int percent, bool random) {
+		kmeans_sample_percent_ = std::max(1, std::min(percent, 100));
+		kmeans_random_sampling_ = random;
+	}
+
+	// Итерации и попытки k-means (по умолчанию 10 и 3; меньше - быстрее, палитра грубее)
+	void setKMeansIterations(int iterations, int attempts) {
+		kmeans_iterations_ = std::max(1, iterations);
+		kmeans_attempts_ = std::max(1, attempts);
+	}
+
+	// Назначение пикселей через LUT 32x32x32 (действует при обучении на подвыборке)
+	void setPaletteLut(bool enabled) {
+		palette_lut_enabled_ = enabled;
+	}
+
+	// Точное назначение через SIMD-ядро effect_kernels::assignRowNearest (false - скалярный float-цикл)
+	void setSimdAssignment(bool enabled) {
+		simd_assign_enabled_ = enabled;
+	}
+
+	// Специализированные ядра назначения для уровней 4/6/8/16 и черных/белых контуров (false - общее ядро)
+	void setSpecializedKernels(bool enabled) {
+		specialized_kernels_ = enabled;
+		selectKernels();
+	}
+
+	// Параллельная обработка полосами: strips > 1 включает путь cv::parallel_for_
+	void setParallelStrips(int strips) {
+		parallel_strips_ = std::max(0, strips);
+	}
+
+	// Целочисленный k-means (effect_kernels::kmeansInt): без копии кадра в CV_32F, центры - целые BGR.
+	// Допуск качества: RMSE к исходному кадру не более чем на 5% + 0.5 выше, чем у cv::kmeans (проверка в 4_Benchmark)
+	void setIntegerKMeans(bool enabled) {
+		integer_kmeans_ = enabled;
+	}
+
+	// Палитра median cut (effect_kernels::medianCutPalette) вместо k-means: без случайного посева,
+	// одинаковые кадры на разных Worker'ах дают одинаковую палитру. Выборка пикселей - как у k-means
+	void setMedianCutPalette(bool enabled) {
+		median_cut_ = enabled;
+	}
+
+	// Однопроходный вывод (false - отдельные colorQuantization и combineEffect, как раньше)
+	void setFusedOutput(bool enabled) {
+		fused_output_enabled_ = enabled;
+	}
+
+	// Текущая палитра (после последнего обучения или usePalette)
+	const std::vector<cv::Vec3b>& palette() const {
+		return palette_;
+	}
+
+	// Установка готовой палитры (например, сохраненной для потока) для applyEffectRegion
+	void usePalette(const std::vector<cv::Vec3b>& colors) {
+		setPalette(colors);
+		if (palette_lut_enabled_) {
+			updatePaletteLut();  // Перестроение только при смене палитры
+		}
+	}
+
+	// Счетчик пересозданий внутренних буферов (после первого кадра растет только при смене размера)
+	uint64_t scratchReallocations() const {
+		return scratch_reallocations_;
 	}
 
 	cv::Mat applyEffect(const cv::Mat& input_frame) {
+		cv::Mat result;
+		applyEffect(input_frame, result);
+		return result;
+	}
+
+	// Эффект в выходной буфер вызывающего: при неизменном размере кадра output и внутренние буферы
+	// переиспользуются, новых кадровых буферов не выделяется.
+	// Серый кадр (CV_8UC1) обрабатывается одноканальным путем (applyEffectGray), результат тоже серый
+	void applyEffect(const cv::Mat& input_frame, cv::Mat& output) {
 		if (input_frame.empty()) {
 			throw std::invalid_argument("Input frame is empty");
 		}
+		if (input_frame.channels() == 1) {
+			applyEffectGray(input_frame, output);
+			return;
+		}
+		if (parallel_strips_ > 1) {
+			applyEffectParallel(input_frame, output);  // Полосы с общей палитрой
+			return;
+		}
+		if (fused_output_enabled_) {
+			// Сначала контуры, затем цвет палитры или контура сразу в результат
+			detectEdges(input_frame, edges_);
+			quantizeWithContours(input_frame, edges_, output);
+			return;
+		}
 
 		// 1. Упрощение цветов (квантование)
 		cv::Mat quantized = colorQuantization(input_frame);
@@ -48,13 +182,15 @@ public:
 		cv::Mat edges = extractEdges(input_frame);
 
 		// 3. Комбинирование с черными контурами
-		cv::Mat result = combineEffect(quantized, edges);
-
-		return result;
+		output = combineEffect(quantized, edges);
 	}
 
-private:
+	// Этапы эффекта (открыты для бенчмарка 4_Benchmark)
 	cv::Mat colorQuantization(const cv::Mat& image) {
+		if (kmeans_sample_percent_ < 100 || integer_kmeans_ || median_cut_) {
+			return colorQuantizationSubsampled(image);  // Обучение на подвыборке, целочисленный k-means или median cut
+		}
+
 		// Преобразование изображения в одномерный массив пикселей
 		cv::Mat data = image.reshape(1, image.rows * image.cols);
 		data.convertTo(data, CV_32F);  // Конвертация в float для k-means
@@ -62,8 +198,8 @@ private:
 		cv::Mat centers;  // Центры кластеров (цвета)
 		// Алгоритм k-means для квантования цвета
 		cv::kmeans(data, color_quantization_levels_, labels,
-			cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::MAX_ITER, 10, 1.0),
-			3, cv::KMEANS_PP_CENTERS, centers);
+			cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::MAX_ITER, kmeans_iterations_, 1.0),
+			kmeans_attempts_, cv::KMEANS_PP_CENTERS, centers);
 		// Создание квантованного изображения
 		cv::Mat quantized(image.size(), image.type());
 		for (int i = 0; i < image.rows * image.cols; i++) {
@@ -79,28 +215,192 @@ private:
 	}
 
 	cv::Mat extractEdges(const cv::Mat& image) {
-		cv::Mat gray, blur, edges;
+		cv::Mat edges;  // Новая матрица: результат не разделяет память с буферами эффекта
+		detectEdges(image, edges);
+		if (thickContours()) {
+			dilateEdgeBits(edges);
+			effect_kernels::unpackMask(dilated_bits_, edges);  // Байтовая маска для combineEffect
+		}
+		return edges;
+	}
 
-		// Конвертация в оттенки серого для детектора краев
-		cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+	// Контуры через полосы: серый и размытие по полосам с ореолом, Canny - по всему кадру
+	cv::Mat extractEdgesStrips(const cv::Mat& image) {
+		cv::Mat edges;
+		detectEdgesStrips(image, edges);
+		if (thickContours()) {
+			dilateEdgeBits(edges);
+			effect_kernels::unpackMask(dilated_bits_, edges);
+		}
+		return edges;
+	}
 
-		// Размытие Гаусса для уменьшения шума // Меньшее размытие для более четких контуров
-		cv::GaussianBlur(gray, blur,
-			cv::Size(gaussian_kernel_size_, gaussian_kernel_size_), 0);
+	// Квантование с наложением контуров за один проход: без clone() и отдельных setTo / cvtColor + +=.
+	// Толстые контуры - битовая маска после дилатации, накладывается поверх цветов палитры
+	void quantizeWithContours(const cv::Mat& image, const cv::Mat& edges, cv::Mat& output) {
+		trainPalette(image);
+		// Полный cv::kmeans: метки всех пикселей уже есть, назначение не нужно
+		paletteWithContours(image, edges, output, kmeans_sample_percent_ >= 100 && !integer_kmeans_ && !median_cut_);
+	}
 
-		// Детекция границ алгоритмом Кэнни
-		cv::Canny(blur, edges, canny_low_threshold_, canny_high_threshold_);
+	// Общая палитра пакета кадров одного потока (Worker, worker_batch_max): одно обучение на объединенной
+	// подвыборке всех кадров вместо обучения на каждом. Доля выборки кадра делится на число кадров, поэтому
+	// точек столько же, сколько у одного кадра (но не меньше 32 на кластер с каждого). Соседние кадры
+	// получают одинаковую палитру и не мерцают. Серые кадры - общие уровни по сумме гистограмм
+	void trainSharedPalette(const std::vector<cv::Mat>& frames) {
+		if (frames.empty() || frames[0].empty()) {
+			throw std::invalid_argument("Batch is empty");
+		}
+		if (frames[0].channels() == 1) {
+			uint32_t hist[256] = {};
+			for (const cv::Mat& frame : frames) {
+				accumulateGrayHistogram(frame, hist);
+			}
+			setGrayLevels(hist);
+			return;
+		}
+		if (frames.size() == 1) {
+			trainPalette(frames[0]);
+			return;
+		}
+		const int percent = std::max(1, kmeans_sample_percent_ / static_cast<int>(frames.size()));
+		const bool integer = median_cut_ || integer_kmeans_;
+		kmeans_samples_.clear();
+		kmeans_int_samples_.clear();
+		for (const cv::Mat& frame : frames) {
+			if (integer) {
+				sampleKMeansPixels(frame, frame_int_samples_, percent);
+				kmeans_int_samples_.insert(kmeans_int_samples_.end(), frame_int_samples_.begin(), frame_int_samples_.end());
+			}
+			else {
+				sampleKMeansPixels(frame, frame_samples_, percent);
+				kmeans_samples_.insert(kmeans_samples_.end(), frame_samples_.begin(), frame_samples_.end());
+			}
+		}
 
-		// Убрал dilation для тонких контуров
-		// Если нужны чуть толще контуры, можно раскомментировать:
-		/*
-		if (dilation_kernel_size_ > 0) {
-			cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT,
-							cv::Size(dilation_kernel_size_, dilation_kernel_size_));
-			cv::dilate(edges, edges, kernel);
+		if (median_cut_) {
+			effect_kernels::medianCutPalette(kmeans_int_samples_.data(), static_cast<int>(kmeans_int_samples_.size()),
+				color_quantization_levels_, median_cut_buffers_, median_cut_palette_);
+			setPalette(median_cut_palette_);
+		}
+		else if (integer_kmeans_) {
+			effect_kernels::kmeansInt(kmeans_int_samples_.data(), static_cast<int>(kmeans_int_samples_.size()),
+				color_quantization_levels_, kmeans_iterations_, kmeans_attempts_, cv::theRNG(), kmeans_int_buffers_);
+			setPalette(kmeans_int_buffers_.best);
+		}
+		else {
+			cv::Mat data(static_cast<int>(kmeans_samples_.size()), 3, CV_32F, kmeans_samples_.data());  // Обертка без копирования
+			ensureBuffer(kmeans_centers_, cv::Size(3, color_quantization_levels_), CV_32F);
+			cv::kmeans(data, color_quantization_levels_, kmeans_labels_,
+				cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::MAX_ITER, kmeans_iterations_, 1.0),
+				kmeans_attempts_, cv::KMEANS_PP_CENTERS, kmeans_centers_);
+			setPalette(kmeans_centers_);
+		}
+		if (palette_lut_enabled_) {
+			updatePaletteLut();
 		}
-		*/
-		return edges;
+	}
+
+	// Эффект с текущей палитрой (после trainSharedPalette или usePalette) без обучения: назначение цветов
+	// и контуры, как в однопроходном выводе. Серый кадр - текущие уровни яркости
+	void applyEffectWithPalette(const cv::Mat& input_frame, cv::Mat& output) {
+		if (input_frame.empty()) {
+			throw std::invalid_argument("Input frame is empty");
+		}
+		if (input_frame.channels() == 1) {
+			if (gray_levels_.empty()) {
+				throw std::logic_error("Gray levels are not trained");
+			}
+			grayWithContours(input_frame, output);
+			return;
+		}
+		if (palette_.empty()) {
+			throw std::logic_error("Palette is not trained");
+		}
+		detectEdges(input_frame, edges_);
+		paletteWithContours(input_frame, edges_, output, false);
+	}
+
+	// Быстрый уровень: квантование и контуры по кадру, уменьшенному в scale раз (например, IMREAD_REDUCED_COLOR_2/_4),
+	// результат размера full_size - цвета палитры ближайшим соседом, контуры тонкими линиями (upscaleEdgesThin)
+	void applyEffectUpscaled(const cv::Mat& reduced_frame, int scale, cv::Size full_size, cv::Mat& output) {
+		if (reduced_frame.empty()) {
+			throw std::invalid_argument("Input frame is empty");
+		}
+		if (scale <= 1) {
+			applyEffect(reduced_frame, output);  // Полное разрешение
+			return;
+		}
+		detectEdges(reduced_frame, edges_);
+		ensureBuffer(reduced_quantized_, reduced_frame.size(), reduced_frame.type());
+		if (reduced_frame.channels() == 1) {
+			trainGrayLevels(reduced_frame);
+			cv::LUT(reduced_frame, gray_lut_, reduced_quantized_);
+		}
+		else {
+			trainPalette(reduced_frame);
+			assignRows(reduced_frame, reduced_quantized_, cv::Range(0, reduced_frame.rows), cv::Mat(), 0);
+		}
+
+		ensureBuffer(upscaled_edges_, full_size, CV_8UC1);
+		upscaled_edges_.setTo(0);
+		effect_kernels::upscaleEdgesThin(edges_, scale, upscaled_edges_);
+		if (thickContours()) {
+			dilateEdgeBits(upscaled_edges_);  // Толщина в пикселях полного кадра
+			effect_kernels::unpackMask(dilated_bits_, upscaled_edges_);
+		}
+
+		// Увеличение палитры ближайшим соседом вместе с наложением контуров за один проход
+		output.create(full_size, reduced_frame.type());
+		const uchar contour = contourValue();
+		if (reduced_frame.channels() == 1) {
+			for (int y = 0; y < full_size.height; y++) {
+				const uchar* src = reduced_quantized_.ptr<uchar>(std::min(y / scale, reduced_frame.rows - 1));
+				const uchar* mask = upscaled_edges_.ptr<uchar>(y);
+				uchar* dst = output.ptr<uchar>(y);
+				for (int x = 0; x < full_size.width; x++) {
+					dst[x] = mask[x] ? contour : src[std::min(x / scale, reduced_frame.cols - 1)];
+				}
+			}
+			return;
+		}
+		const cv::Vec3b contour_color(contour, contour, contour);
+		for (int y = 0; y < full_size.height; y++) {
+			const cv::Vec3b* src = reduced_quantized_.ptr<cv::Vec3b>(std::min(y / scale, reduced_frame.rows - 1));
+			const uchar* mask = upscaled_edges_.ptr<uchar>(y);
+			cv::Vec3b* dst = output.ptr<cv::Vec3b>(y);
+			for (int x = 0; x < full_size.width; x++) {
+				dst[x] = mask[x] ? contour_color : src[std::min(x / scale, reduced_frame.cols - 1)];
+			}
+		}
+	}
+
+	// Пересчет прямоугольника region кадра в output (результат предыдущего кадра того же размера)
+	// с текущей палитрой без обучения. Контуры считаются по области с ореолом: размытие и окрестность
+	// Собеля / подавления немаксимумов совпадают с полным кадром, гистерезис Canny - только внутри ореола
+	void applyEffectRegion(const cv::Mat& input_frame, const cv::Rect& region, cv::Mat& output) {
+		if (palette_.empty() || output.size() != input_frame.size() || output.type() != input_frame.type()) {
+			throw std::logic_error("Region update requires a processed frame of the same size");
+		}
+		const int margin = gaussian_kernel_size_ / 2 + 2  // Ореол: полуширина ядра Гаусса + Собель + соседи NMS
+			+ (thickContours() ? dilation_kernel_size_ / 2 : 0);  // + радиус дилатации
+		const cv::Rect outer = cv::Rect(region.x - margin, region.y - margin,
+			region.width + 2 * margin, region.height + 2 * margin) & cv::Rect(0, 0, input_frame.cols, input_frame.rows);
+
+		cv::cvtColor(input_frame(outer), region_gray_, cv::COLOR_BGR2GRAY);
+		cv::GaussianBlur(region_gray_, region_blur_, cv::Size(gaussian_kernel_size_, gaussian_kernel_size_), 0);
+		cv::Canny(region_blur_, region_edges_, canny_low_threshold_, canny_high_threshold_);
+
+		cv::Mat output_region = output(region);
+		if (thickContours()) {
+			dilateEdgeBits(region_edges_);
+			assignRows(input_frame(region), output_region, cv::Range(0, region.height), cv::Mat(), 0);
+			const cv::Point offset = region.tl() - outer.tl();
+			overlayDilated(output_region, cv::Range(0, region.height), offset.y, offset.x);
+			return;
+		}
+		assignRows(input_frame(region), output_region, cv::Range(0, region.height),
+			region_edges_(region - outer.tl()), contourValue());
 	}
 
 	cv::Mat combineEffect(const cv::Mat& quantized, const cv::Mat& edges) {
@@ -118,4 +418,444 @@ private:
 		}
 		return result;
 	}
+
+private:
+	// Пересоздание буфера только при смене размера или типа (иначе память переиспользуется)
+	void ensureBuffer(cv::Mat& buffer, cv::Size size, int type) {
+		if (buffer.size() != size || buffer.type() != type) {
+			buffer.create(size, type);
+			scratch_reallocations_++;
+		}
+	}
+
+	// Контуры в edges через буферы gray_ и blur_ эффекта (серый кадр размывается напрямую, без gray_)
+	void detectEdges(const cv::Mat& image, cv::Mat& edges) {
+		ensureBuffer(blur_, image.size(), CV_8UC1);
+		if (&edges == &edges_) {
+			ensureBuffer(edges_, image.size(), CV_8UC1);  // Canny пишет в готовый буфер без выделения
+		}
+
+		// Конвертация в оттенки серого для детектора краев
+		const cv::Mat* gray = &image;
+		if (image.channels() != 1) {
+			ensureBuffer(gray_, image.size(), CV_8UC1);
+			cv::cvtColor(image, gray_, cv::COLOR_BGR2GRAY);
+			gray = &gray_;
+		}
+
+		// Размытие Гаусса для уменьшения шума // Меньшее размытие для более четких контуров
+		cv::GaussianBlur(*gray, blur_,
+			cv::Size(gaussian_kernel_size_, gaussian_kernel_size_), 0);
+
+		// Детекция границ алгоритмом Кэнни
+		cv::Canny(blur_, edges, canny_low_threshold_, canny_high_threshold_);
+
+		// Утолщение (dilation_kernel_size_ > 1) - не cv::dilate по байтовой маске, а по битовой: dilateEdgeBits
+	}
+
+	// Одноканальный путь: уровни яркости по гистограмме вместо палитры BGR, назначение - cv::LUT,
+	// контуры - та же маска Кэнни (толстые - через битовую дилатацию). Данных в 3 раза меньше, чем у BGR
+	void applyEffectGray(const cv::Mat& input_frame, cv::Mat& output) {
+		trainGrayLevels(input_frame);
+		grayWithContours(input_frame, output);
+	}
+
+	// Уровни яркости текущей LUT и контуры серого кадра (без обучения)
+	void grayWithContours(const cv::Mat& input_frame, cv::Mat& output) {
+		detectEdges(input_frame, edges_);
+		cv::LUT(input_frame, gray_lut_, output);
+		if (thickContours()) {
+			dilateEdgeBits(edges_);
+			effect_kernels::unpackMask(dilated_bits_, edges_);
+		}
+		output.setTo(contourValue(), edges_);
+	}
+
+	// Уровни яркости: гистограмма всего кадра (один проход), одномерный k-means по 256 бинам
+	// (effect_kernels::grayLevelsKMeans), затем LUT ближайшего уровня для каждой яркости
+	void trainGrayLevels(const cv::Mat& image) {
+		uint32_t hist[256] = {};
+		accumulateGrayHistogram(image, hist);
+		setGrayLevels(hist);
+	}
+
+	static void accumulateGrayHistogram(const cv::Mat& image, uint32_t* hist) {
+		for (int y = 0; y < image.rows; y++) {
+			const uchar* row = image.ptr<uchar>(y);
+			for (int x = 0; x < image.cols; x++) {
+				hist[row[x]]++;
+			}
+		}
+	}
+
+	void setGrayLevels(const uint32_t* hist) {
+		effect_kernels::grayLevelsKMeans(hist, color_quantization_levels_, kmeans_iterations_, gray_levels_);
+		ensureBuffer(gray_lut_, cv::Size(256, 1), CV_8UC1);
+		uchar* lut = gray_lut_.ptr<uchar>();
+		size_t level = 0;
+		for (int v = 0; v < 256; v++) {
+			while (level + 1 < gray_levels_.size() && gray_levels_[level + 1] - v <= v - gray_levels_[level]) {
+				level++;
+			}
+			lut[v] = gray_levels_[level];
+		}
+	}
+
+	// Цвета текущей палитры с контурами в output. use_labels - метки всех пикселей есть после полного cv::kmeans
+	void paletteWithContours(const cv::Mat& image, const cv::Mat& edges, cv::Mat& output, bool use_labels) {
+		output.create(image.size(), image.type());  // Без выделения, если буфер вызывающего уже нужного размера
+		const uchar contour = contourValue();  // Выбор черного/белого вынесен из цикла
+		const bool thick = thickContours();
+		if (thick) {
+			dilateEdgeBits(edges);
+		}
+		const cv::Mat mask = thick ? cv::Mat() : edges;  // Тонкие контуры - сразу при назначении
+		if (!use_labels) {
+			assignRows(image, output, cv::Range(0, image.rows), mask, contour);
+		}
+		else {
+			for (int y = 0; y < image.rows; y++) {
+				effect_kernels::paletteRowWithContours(&kmeans_labels_[static_cast<size_t>(y) * image.cols],
+					mask.empty() ? nullptr : mask.ptr<uchar>(y), output.ptr<uchar>(y), image.cols, palette_.data(), contour);
+			}
+		}
+		if (thick) {
+			overlayDilated(output, cv::Range(0, image.rows), 0, 0);
+		}
+	}
+
+	// Толстые контуры включены (ядро 0 или 1 - тонкие контуры Кэнни)
+	bool thickContours() const {
+		return dilation_kernel_size_ > 1;
+	}
+
+	// Упаковка маски контуров в биты и дилатация в dilated_bits_ (64 пикселя за операцию, маска в 8 раз меньше)
+	void dilateEdgeBits(const cv::Mat& edges) {
+		effect_kernels::packMask(edges, edge_bits_);
+		effect_kernels::dilateBits(edge_bits_, dilation_kernel_size_, dilated_bits_, dilation_scratch_);
+	}
+
+	// Наложение контура из dilated_bits_ на строки rows результата; (row_offset, col_offset) - положение
+	// output(0, 0) в маске (для области с ореолом)
+	void overlayDilated(cv::Mat& output, const cv::Range& rows, int row_offset, int col_offset) const {
+		const uchar contour = contourValue();
+		for (int y = rows.start; y < rows.end; y++) {
+			effect_kernels::overlayRowBits(dilated_bits_.row(y + row_offset), col_offset,
+				output.ptr<uchar>(y), output.cols, contour);
+		}
+	}
+
+	// Контуры через полосы в edges: серый и размытие по полосам с ореолом в blur_, Canny - по всему кадру
+	void detectEdgesStrips(const cv::Mat& image, cv::Mat& edges) {
+		const int strips = std::max(1, std::min(parallel_strips_, image.rows));
+		ensureBuffer(blur_, image.size(), CV_8UC1);
+		if (&edges == &edges_) {
+			ensureBuffer(edges_, image.size(), CV_8UC1);
+		}
+		if (static_cast<int>(strip_gray_.size()) != strips) {
+			strip_gray_.resize(strips);
+			strip_blur_.resize(strips);
+		}
+		cv::parallel_for_(cv::Range(0, strips), [&](const cv::Range& range) {
+			for (int s = range.start; s < range.end; s++) {
+				blurStrip(image, s, stripRows(image.rows, strips, s));
+			}
+		});
+		cv::Canny(blur_, edges, canny_low_threshold_, canny_high_threshold_);  // Canny внутри распараллелен OpenCV
+	}
+
+	// Квантование с отдельными обучением палитры и проходом назначения
+	cv::Mat colorQuantizationSubsampled(const cv::Mat& image) {
+		trainPalette(image);
+		// Назначение каждого пикселя изображения ближайшему центру
+		cv::Mat quantized(image.size(), image.type());
+		assignRows(image, quantized, cv::Range(0, image.rows), cv::Mat(), 0);
+		return quantized;
+	}
+
+	// Обучение палитры k-means на подвыборке (или на всех пикселях при 100%)
+	void trainPalette(const cv::Mat& image) {
+		if (median_cut_ || integer_kmeans_) {
+			if (median_cut_) {
+				trainPaletteMedianCut(image);
+			}
+			else {
+				trainPaletteInteger(image);
+			}
+			if (palette_lut_enabled_) {
+				updatePaletteLut();
+			}
+			return;
+		}
+		if (kmeans_sample_percent_ < 100) {
+			sampleKMeansPixels(image, kmeans_samples_, kmeans_sample_percent_);  // Подвыборка пикселей в kmeans_samples_
+		}
+		else {
+			sampleAllPixels(image, kmeans_samples_);
+		}
+		cv::Mat data(static_cast<int>(kmeans_samples_.size()), 3, CV_32F, kmeans_samples_.data());  // Обертка без копирования
+		ensureBuffer(kmeans_centers_, cv::Size(3, color_quantization_levels_), CV_32F);  // Центры кластеров (цвета)
+		cv::kmeans(data, color_quantization_levels_, kmeans_labels_,
+			cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::MAX_ITER, kmeans_iterations_, 1.0),
+			kmeans_attempts_, cv::KMEANS_PP_CENTERS, kmeans_centers_);
+		setPalette(kmeans_centers_);
+		if (palette_lut_enabled_) {
+			updatePaletteLut();  // Перестроение только при смене палитры
+		}
+	}
+
+	// Целочисленный k-means прямо по 8-битным пикселям (те же итерации, EPS 1 и попытки k-means++, что у cv::kmeans)
+	void trainPaletteInteger(const cv::Mat& image) {
+		int count = 0;
+		const cv::Vec3b* samples = integerSamples(image, count);
+		effect_kernels::kmeansInt(samples, count, color_quantization_levels_, kmeans_iterations_, kmeans_attempts_,
+			cv::theRNG(), kmeans_int_buffers_);
+		setPalette(kmeans_int_buffers_.best);
+	}
+
+	// Палитра median cut по той же выборке, что у целочисленного k-means
+	void trainPaletteMedianCut(const cv::Mat& image) {
+		int count = 0;
+		const cv::Vec3b* samples = integerSamples(image, count);
+		effect_kernels::medianCutPalette(samples, count, color_quantization_levels_, median_cut_buffers_,
+			median_cut_palette_);
+		setPalette(median_cut_palette_);
+	}
+
+	// 8-битные пиксели для обучения: весь непрерывный кадр без копирования или подвыборка в kmeans_int_samples_
+	const cv::Vec3b* integerSamples(const cv::Mat& image, int& count) {
+		if (kmeans_sample_percent_ >= 100 && image.isContinuous()) {
+			count = image.rows * image.cols;
+			return image.ptr<cv::Vec3b>();
+		}
+		if (kmeans_sample_percent_ < 100) {
+			sampleKMeansPixels(image, kmeans_int_samples_, kmeans_sample_percent_);
+		}
+		else {
+			sampleAllPixels(image, kmeans_int_samples_);
+		}
+		count = static_cast<int>(kmeans_int_samples_.size());
+		return kmeans_int_samples_.data();
+	}
+
+	// Назначение цветов палитры строкам [rows.start, rows.end) (потокобезопасно после trainPalette).
+	// Непустая edges - маска контуров: там пишется contour во все каналы
+	void assignRows(const cv::Mat& image, cv::Mat& quantized, const cv::Range& rows,
+		const cv::Mat& edges, uchar contour) const {
+		if (palette_lut_enabled_) {
+			assignWithLut(image, quantized, rows, edges, contour);
+		}
+		else {
+			assignNearestCenters(image, quantized, rows, edges, contour);
+		}
+	}
+
+	// Значение канала для контуров: черный 0, белый 255 (как насыщение при сложении в combineEffect)
+	uchar contourValue() const {
+		return black_contours_ ? 0 : 255;
+	}
+
+	// Выбор ядра назначения один раз при настройке (не на каждом кадре)
+	void selectKernels() {
+		assign_row_ = specialized_kernels_
+			? effect_kernels::selectAssignRow(color_quantization_levels_, contourValue())
+			: &effect_kernels::assignRowNearestT<0, -1>;
+	}
+
+	// Строки полосы s из strips (равные части высоты)
+	static cv::Range stripRows(int height, int strips, int s) {
+		return cv::Range(height * s / strips, height * (s + 1) / strips);
+	}
+
+	// Серый и размытие Гаусса для полосы s в blur_: ореол gaussian_kernel_size_ / 2 строк сверху и снизу
+	// дает внутренним строкам тех же соседей, что и при размытии всего кадра (результат совпадает побитно).
+	// Буферы полосы свои у каждой s, размер меняется только вместе с размером кадра
+	void blurStrip(const cv::Mat& image, int s, const cv::Range& rows) {
+		const int halo = gaussian_kernel_size_ / 2;
+		const int top = std::max(0, rows.start - halo);
+		const int bottom = std::min(image.rows, rows.end + halo);
+		cv::cvtColor(image.rowRange(top, bottom), strip_gray_[s], cv::COLOR_BGR2GRAY);
+		cv::GaussianBlur(strip_gray_[s], strip_blur_[s], cv::Size(gaussian_kernel_size_, gaussian_kernel_size_), 0);
+		strip_blur_[s].rowRange(rows.start - top, rows.end - top).copyTo(blur_.rowRange(rows));
+	}
+
+	// Параллельный эффект: общая палитра, полосы для размытия и назначения цветов,
+	// Canny по всему размытому кадру (гистерезис нелокален - так контуры совпадают с последовательным путем)
+	void applyEffectParallel(const cv::Mat& input_frame, cv::Mat& output) {
+		trainPalette(input_frame);  // Одна палитра на все полосы
+		const int strips = std::min(parallel_strips_, input_frame.rows);
+		detectEdgesStrips(input_frame, edges_);
+
+		// Цвет палитры или контура сразу в результат (однопроходный вывод по полосам)
+		output.create(input_frame.size(), input_frame.type());
+		const uchar contour = contourValue();
+		const bool thick = thickContours();
+		if (thick) {
+			dilateEdgeBits(edges_);  // Дилатация по всему кадру, наложение - по полосам
+		}
+		const cv::Mat mask = thick ? cv::Mat() : edges_;
+		cv::parallel_for_(cv::Range(0, strips), [&](const cv::Range& range) {
+			for (int s = range.start; s < range.end; s++) {
+				const cv::Range rows = stripRows(input_frame.rows, strips, s);
+				assignRows(input_frame, output, rows, mask, contour);
+				if (thick) {
+					overlayDilated(output, rows, 0, 0);
+				}
+			}
+		});
+	}
+
+	// Сохранение центров k-means как текущей палитры
+	void setPalette(const cv::Mat& centers) {
+		center_colors_.resize(centers.rows);
+		palette_.resize(centers.rows);
+		for (int j = 0; j < centers.rows; j++) {
+			center_colors_[j] = centers.at<cv::Vec3f>(j);
+			palette_[j] = center_colors_[j];  // saturate_cast при преобразовании Vec3f -> Vec3b (как в полном пути)
+		}
+	}
+
+	// Целые центры (целочисленный k-means) как текущая палитра
+	void setPalette(const std::vector<cv::Vec3b>& colors) {
+		center_colors_.resize(colors.size());
+		palette_.resize(colors.size());
+		for (size_t j = 0; j < colors.size(); j++) {
+			palette_[j] = colors[j];
+			center_colors_[j] = cv::Vec3f(colors[j][0], colors[j][1], colors[j][2]);
+		}
+	}
+
+	// Индекс ближайшего центра палитры для цвета (b, g, r)
+	int nearestCenter(float b, float g, float r) const {
+		float best_dist = FLT_MAX;
+		int best_idx = 0;
+		for (size_t j = 0; j < center_colors_.size(); j++) {
+			float db = b - center_colors_[j][0];
+			float dg = g - center_colors_[j][1];
+			float dr = r - center_colors_[j][2];
+			float dist = db * db + dg * dg + dr * dr;
+			if (dist < best_dist) {
+				best_dist = dist;
+				best_idx = static_cast<int>(j);
+			}
+		}
+		return best_idx;
+	}
+
+	// Построение LUT: для центра каждой ячейки 32x32x32 - индекс ближайшего центра палитры
+	void updatePaletteLut() {
+		if (!palette_lut_.empty() && lut_centers_ == center_colors_) {
+			return;  // Палитра не изменилась
+		}
+		const int cells = 1 << kLutBits;  // Ячеек на канал
+		const int shift = 8 - kLutBits;  // Сдвиг 8-битного значения в индекс ячейки
+		const float half = static_cast<float>(1 << (shift - 1));  // Центр ячейки
+		palette_lut_.resize(static_cast<size_t>(cells) * cells * cells);
+		for (int b = 0; b < cells; b++) {
+			for (int g = 0; g < cells; g++) {
+				uchar* lut_row = &palette_lut_[(static_cast<size_t>(b) * cells + g) * cells];
+				for (int r = 0; r < cells; r++) {
+					lut_row[r] = static_cast<uchar>(nearestCenter(
+						static_cast<float>(b << shift) + half,
+						static_cast<float>(g << shift) + half,
+						static_cast<float>(r << shift) + half));
+				}
+			}
+		}
+		lut_centers_ = center_colors_;
+	}
+
+	// Назначение цветов одной выборкой из LUT на пиксель (с маской контуров, если edges не пуста)
+	void assignWithLut(const cv::Mat& image, cv::Mat& quantized, const cv::Range& rows,
+		const cv::Mat& edges, uchar contour) const {
+		const int shift = 8 - kLutBits;
+		const uchar* lut = palette_lut_.data();
+		const cv::Vec3b* palette = palette_.data();
+		const cv::Vec3b contour_color(contour, contour, contour);
+		for (int y = rows.start; y < rows.end; y++) {
+			const uchar* src = image.ptr<uchar>(y);
+			cv::Vec3b* dst = quantized.ptr<cv::Vec3b>(y);
+			const uchar* mask = edges.empty() ? nullptr : edges.ptr<uchar>(y);
+			if (!mask) {
+				for (int x = 0; x < image.cols; x++, src += 3) {
+					int idx = ((src[0] >> shift) << (2 * kLutBits)) | ((src[1] >> shift) << kLutBits) | (src[2] >> shift);
+					dst[x] = palette[lut[idx]];
+				}
+				continue;
+			}
+			for (int x = 0; x < image.cols; x++, src += 3) {
+				int idx = ((src[0] >> shift) << (2 * kLutBits)) | ((src[1] >> shift) << kLutBits) | (src[2] >> shift);
+				dst[x] = mask[x] ? contour_color : palette[lut[idx]];
+			}
+		}
+	}
+
+	// Выборка percent % пикселей для обучения: случайная (фиксированный seed) или равномерная сетка.
+	// Pixel - cv::Vec3f (cv::kmeans) или cv::Vec3b (целочисленный k-means)
+	template <typename Pixel>
+	void sampleKMeansPixels(const cv::Mat& image, std::vector<Pixel>& samples, int percent) {
+		const int total = image.rows * image.cols;  // Всего пикселей
+		int count = static_cast<int>(static_cast<int64_t>(total) * percent / 100);
+		count = std::min(total, std::max(count, color_quantization_levels_ * 32));  // Не меньше 32 точек на кластер
+		samples.clear();
+
+		if (kmeans_random_sampling_) {
+			cv::RNG rng(0x2545F491);  // Фиксированный seed - одинаковая выборка от кадра к кадру
+			for (int i = 0; i < count; i++) {
+				int idx = rng.uniform(0, total);  // Случайный пиксель
+				const cv::Vec3b& p = image.at<cv::Vec3b>(idx / image.cols, idx % image.cols);
+				samples.emplace_back(p[0], p[1], p[2]);
+			}
+		}
+		else {
+			// Сетка с шагом step, нечетные ряды сдвинуты на полшага (меньше совпадений с вертикальными структурами)
+			const double step = std::sqrt(static_cast<double>(total) / count);
+			int row_index = 0;
+			for (double y = step / 2; y < image.rows; y += step, row_index++) {
+				const cv::Vec3b* row = image.ptr<cv::Vec3b>(static_cast<int>(y));
+				for (double x = (row_index % 2) ? step / 2 : 0.0; x < image.cols; x += step) {
+					const cv::Vec3b& p = row[static_cast<int>(x)];
+					samples.emplace_back(p[0], p[1], p[2]);
+				}
+			}
+			if (static_cast<int>(samples.size()) < color_quantization_levels_) {  // Вырожденно малое изображение
+				sampleAllPixels(image, samples);
+			}
+		}
+	}
+
+	// Все пиксели в выборку (обучение на 100% или слишком мелкая сетка)
+	template <typename Pixel>
+	void sampleAllPixels(const cv::Mat& image, std::vector<Pixel>& samples) {
+		samples.clear();
+		for (int y = 0; y < image.rows; y++) {
+			const cv::Vec3b* row = image.ptr<cv::Vec3b>(y);
+			for (int x = 0; x < image.cols; x++) {
+				samples.emplace_back(row[x][0], row[x][1], row[x][2]);
+			}
+		}
+	}
+
+	// Назначение каждого пикселя ближайшему центру (евклидово расстояние в BGR), проход по строкам
+	void assignNearestCenters(const cv::Mat& image, cv::Mat& quantized, const cv::Range& rows,
+		const cv::Mat& edges, uchar contour) const {
+		if (simd_assign_enabled_) {
+			// Расстояния до округленных цветов палитры в целых числах, цвет (или контур) пишется сразу в результат
+			for (int y = rows.start; y < rows.end; y++) {
+				assign_row_(image.ptr<uchar>(y), quantized.ptr<uchar>(y), nullptr,
+					image.cols, palette_.data(), static_cast<int>(palette_.size()),
+					edges.empty() ? nullptr : edges.ptr<uchar>(y), contour);  // Палитра другого размера - общее ядро внутри
+			}
+			return;
+		}
+		const cv::Vec3b contour_color(contour, contour, contour);
+		for (int y = rows.start; y < rows.end; y++) {
+			const cv::Vec3b* src = image.ptr<cv::Vec3b>(y);
+			cv::Vec3b* dst = quantized.ptr<cv::Vec3b>(y);
+			const uchar* mask = edges.empty() ? nullptr : edges.ptr<uchar>(y);
+			for (int x = 0; x < image.cols; x++) {
+				dst[x] = (mask && mask[x]) ? contour_color : palette_[nearestCenter(src[x][0], src[x][1], src[x][2])];
+			}
+		}
+	}
 };
\ No newline at end of file
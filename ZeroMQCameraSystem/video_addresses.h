@@ -36,6 +36,32 @@ int effect_gaussian_kernel_size = g_config.get_int("effect_gaussian_kernel_size"
 int effect_dilation_kernel_size = g_config.get_int("effect_dilation_kernel_size", 0);
 int effect_color_quantization_levels = g_config.get_int("effect_color_quantization_levels", 8);
 bool effect_black_contours = g_config.get_bool("effect_black_contours", true);
+int effect_kmeans_sample_percent = g_config.get_int("effect_kmeans_sample_percent", 100);  // Доля пикселей для обучения k-means (%)
+bool effect_kmeans_random_sampling = g_config.get_bool("effect_kmeans_random_sampling", false);  // Случайная подвыборка вместо сетки
+bool effect_palette_lut = g_config.get_bool("effect_palette_lut", false);  // Назначение цветов через 3D LUT
+int effect_parallel_strips = g_config.get_int("effect_parallel_strips", 0);  // Полосы cv::parallel_for_ (0 - последовательно)
+bool effect_kmeans_integer = g_config.get_bool("effect_kmeans_integer", false);  // Целочисленный k-means по 8-битным BGR
+bool effect_median_cut = g_config.get_bool("effect_median_cut", false);  // Детерминированная палитра median cut вместо k-means
+bool effect_incremental = g_config.get_bool("effect_incremental", false);  // Пересчет только измененных плиток
+int effect_incremental_tile = g_config.get_int("effect_incremental_tile", 64);  // Сторона плитки (пиксели)
+int effect_incremental_threshold = g_config.get_int("effect_incremental_threshold", 6);  // Порог средней разности на канал
+int effect_incremental_refresh = g_config.get_int("effect_incremental_refresh", 30);  // Полный пересчет каждые N кадров
+int effect_incremental_idle_ms = g_config.get_int("effect_incremental_idle_ms", 10000);  // Удаление состояния потока без кадров (0 - не удалять)
+int effect_processing_tier = g_config.get_int("effect_processing_tier", 0);  // 0 - полный кадр, 1 - 1/2, 2 - 1/4 (быстрый уровень)
+std::vector<std::string> effect_chain_stages = g_config.get_string_array("effect_chain", { "scanner_darkly" });  // Этапы эффекта по порядку
+int effect_posterize_bits = g_config.get_int("effect_posterize_bits", 3);  // Бит на канал для этапа posterize
+int worker_latency_budget_ms = g_config.get_int("worker_latency_budget_ms", 0);  // Бюджет времени эффекта на кадр (0 - без регулятора)
+int worker_latency_window = g_config.get_int("worker_latency_window", 15);  // Кадров в окне усреднения регулятора
+bool worker_capturer_fan_in = g_config.get_bool("worker_capturer_fan_in", false);  // Подключение ко всем Capturer'ам из списка
+int worker_capturer_credit = g_config.get_int("worker_capturer_credit", 1);  // Кадров, запрошенных у каждого Capturer'а наперед
+int worker_drain_timeout_ms = g_config.get_int("worker_drain_timeout_ms", 3000);  // Предел ожидания drain и отправки результатов
+int worker_cache_entries = g_config.get_int("worker_cache_entries", 0);  // Записей в кэше результатов (0 - кэш выключен)
+int worker_cache_phash_distance = g_config.get_int("worker_cache_phash_distance", -1);  // Порог dHash для похожих кадров (-1 - только точное совпадение)
+std::vector<std::string> worker_cpu_affinity = g_config.get_string_array("worker_cpu_affinity", { "off" });  // off, auto, node или номера физических ядер
+int worker_numa_node = g_config.get_int("worker_numa_node", -1);  // Узел NUMA для auto/node (-1 - любой)
+int worker_cores_per_worker = g_config.get_int("worker_cores_per_worker", 1);  // Физических ядер на Worker при auto
+int worker_batch_max = g_config.get_int("worker_batch_max", 1);  // Кадров в пакете с общей палитрой (1 - без пакетов)
+int worker_outbox_size = g_config.get_int("worker_outbox_size", 8);  // Результатов, ждущих места в очереди Composer'а
 
 // Настройки Composer
 int frame_gap = g_config.get_int("frame_gap", 500);
@@ -48,6 +74,10 @@ g_config.get_pixel_format("proto_pixel_format", video_processing::BGR);
 video_processing::ImageEncoding proto_image_encoding =
 g_config.get_image_encoding("proto_image_encoding", video_processing::JPEG);
 
+// Кодирование обработанного кадра Worker'ом: JPEG или PALETTE_RLE (палитра и серии, без потерь)
+video_processing::ImageEncoding worker_processed_encoding =
+g_config.get_image_encoding("worker_processed_encoding", video_processing::JPEG);
+
 // До конфига присваивал в video_addresses.h, но удалять жалко так что.
 
 ////---------- 0. Начальные условия (входные данные) для всех компонентов ----------
@@ -118,6 +118,8 @@ const ::google::protobuf::uint32 TableStruct_video_5fprocessing_2eproto::offsets
   PROTOBUF_FIELD_OFFSET(::video_processing::VideoFrame, frame_type_),
   offsetof(::video_processing::VideoFrameDefaultTypeInternal, single_image_),
   offsetof(::video_processing::VideoFrameDefaultTypeInternal, image_pair_),
+  PROTOBUF_FIELD_OFFSET(::video_processing::VideoFrame, latency_tier_),
+  PROTOBUF_FIELD_OFFSET(::video_processing::VideoFrame, source_id_),
   PROTOBUF_FIELD_OFFSET(::video_processing::VideoFrame, content_),
 };
 static const ::google::protobuf::internal::MigrationSchema schemas[] PROTOBUF_SECTION_VARIABLE(protodesc_cold) = {
@@ -147,21 +149,23 @@ const char descriptor_table_protodef_video_5fprocessing_2eproto[] =
   "_data\030\005 \001(\014\"j\n\tImagePair\022-\n\010original\030\001 \001"
   "(\0132\033.video_processing.ImageData\022.\n\tproce"
   "ssed\030\002 \001(\0132\033.video_processing.ImageData\""
-  "\350\001\n\nVideoFrame\022\020\n\010frame_id\030\001 \001(\004\022\021\n\ttime"
+  "\221\002\n\nVideoFrame\022\020\n\010frame_id\030\001 \001(\004\022\021\n\ttime"
   "stamp\030\002 \001(\001\022\021\n\tsender_id\030\003 \001(\t\022/\n\nframe_"
   "type\030\004 \001(\0162\033.video_processing.FrameType\022"
   "3\n\014single_image\030\005 \001(\0132\033.video_processing"
   ".ImageDataH\000\0221\n\nimage_pair\030\006 \001(\0132\033.video"
-  "_processing.ImagePairH\000B\t\n\007content*4\n\tFr"
-  "ameType\022\022\n\016CAPTURED_FRAME\020\000\022\023\n\017PROCESSED"
-  "_FRAME\020\001*)\n\013PixelFormat\022\007\n\003RGB\020\000\022\007\n\003BGR\020"
-  "\001\022\010\n\004GRAY\020\002*4\n\rImageEncoding\022\010\n\004JPEG\020\000\022\007"
-  "\n\003PNG\020\001\022\007\n\003BMP\020\002\022\007\n\003RAW\020\003b\006proto3"
+  "_processing.ImagePairH\000\022\024\n\014latency_tier\030"
+  "\007 \001(\r\022\021\n\tsource_id\030\010 \001(\tB\t\n\007content*4\n\tF"
+  "rameType\022\022\n\016CAPTURED_FRAME\020\000\022\023\n\017PROCESSE"
+  "D_FRAME\020\001*)\n\013PixelFormat\022\007\n\003RGB\020\000\022\007\n\003BGR"
+  "\020\001\022\010\n\004GRAY\020\002*E\n\rImageEncoding\022\010\n\004JPEG\020\000\022"
+  "\007\n\003PNG\020\001\022\007\n\003BMP\020\002\022\007\n\003RAW\020\003\022\017\n\013PALETTE_RL"
+  "E\020\004b\006proto3"
   ;
 ::google::protobuf::internal::DescriptorTable descriptor_table_video_5fprocessing_2eproto = {
   false, InitDefaults_video_5fprocessing_2eproto, 
   descriptor_table_protodef_video_5fprocessing_2eproto,
-  "video_processing.proto", &assign_descriptors_table_video_5fprocessing_2eproto, 713,
+  "video_processing.proto", &assign_descriptors_table_video_5fprocessing_2eproto, 771,
 };
 
 void AddDescriptors_video_5fprocessing_2eproto() {
@@ -213,6 +217,7 @@ bool ImageEncoding_IsValid(int value) {
     case 1:
     case 2:
     case 3:
+    case 4:
       return true;
     default:
       return false;
@@ -1099,6 +1104,8 @@ const int VideoFrame::kSenderIdFieldNumber;
 const int VideoFrame::kFrameTypeFieldNumber;
 const int VideoFrame::kSingleImageFieldNumber;
 const int VideoFrame::kImagePairFieldNumber;
+const int VideoFrame::kLatencyTierFieldNumber;
+const int VideoFrame::kSourceIdFieldNumber;
 #endif  // !defined(_MSC_VER) || _MSC_VER >= 1900
 
 VideoFrame::VideoFrame()
@@ -1114,9 +1121,13 @@ VideoFrame::VideoFrame(const VideoFrame& from)
   if (from.sender_id().size() > 0) {
     sender_id_.AssignWithDefault(&::google::protobuf::internal::GetEmptyStringAlreadyInited(), from.sender_id_);
   }
+  source_id_.UnsafeSetDefault(&::google::protobuf::internal::GetEmptyStringAlreadyInited());
+  if (from.source_id().size() > 0) {
+    source_id_.AssignWithDefault(&::google::protobuf::internal::GetEmptyStringAlreadyInited(), from.source_id_);
+  }
   ::memcpy(&frame_id_, &from.frame_id_,
-    static_cast<size_t>(reinterpret_cast<char*>(&frame_type_) -
-    reinterpret_cast<char*>(&frame_id_)) + sizeof(frame_type_));
+    static_cast<size_t>(reinterpret_cast<char*>(&latency_tier_) -
+    reinterpret_cast<char*>(&frame_id_)) + sizeof(latency_tier_));
   clear_has_content();
   switch (from.content_case()) {
     case kSingleImage: {
@@ -1138,9 +1149,10 @@ void VideoFrame::SharedCtor() {
   ::google::protobuf::internal::InitSCC(
       &scc_info_VideoFrame_video_5fprocessing_2eproto.base);
   sender_id_.UnsafeSetDefault(&::google::protobuf::internal::GetEmptyStringAlreadyInited());
+  source_id_.UnsafeSetDefault(&::google::protobuf::internal::GetEmptyStringAlreadyInited());
   ::memset(&frame_id_, 0, static_cast<size_t>(
-      reinterpret_cast<char*>(&frame_type_) -
-      reinterpret_cast<char*>(&frame_id_)) + sizeof(frame_type_));
+      reinterpret_cast<char*>(&latency_tier_) -
+      reinterpret_cast<char*>(&frame_id_)) + sizeof(latency_tier_));
   clear_has_content();
 }
 
@@ -1151,6 +1163,7 @@ VideoFrame::~VideoFrame() {
 
 void VideoFrame::SharedDtor() {
   sender_id_.DestroyNoArena(&::google::protobuf::internal::GetEmptyStringAlreadyInited());
+  source_id_.DestroyNoArena(&::google::protobuf::internal::GetEmptyStringAlreadyInited());
   if (has_content()) {
     clear_content();
   }
@@ -1191,9 +1204,10 @@ void VideoFrame::Clear() {
   (void) cached_has_bits;
 
   sender_id_.ClearToEmptyNoArena(&::google::protobuf::internal::GetEmptyStringAlreadyInited());
+  source_id_.ClearToEmptyNoArena(&::google::protobuf::internal::GetEmptyStringAlreadyInited());
   ::memset(&frame_id_, 0, static_cast<size_t>(
-      reinterpret_cast<char*>(&frame_type_) -
-      reinterpret_cast<char*>(&frame_id_)) + sizeof(frame_type_));
+      reinterpret_cast<char*>(&latency_tier_) -
+      reinterpret_cast<char*>(&frame_id_)) + sizeof(latency_tier_));
   clear_content();
   _internal_metadata_.Clear();
 }
@@ -1275,6 +1289,29 @@ const char* VideoFrame::_InternalParse(const char* begin, const char* end, void*
             {parser_till_end, object}, ptr - size, ptr));
         break;
       }
+      // uint32 latency_tier = 7;
+      case 7: {
+        if (static_cast<::google::protobuf::uint8>(tag) != 56) goto handle_unusual;
+        msg->set_latency_tier(::google::protobuf::internal::ReadVarint(&ptr));
+        GOOGLE_PROTOBUF_PARSER_ASSERT(ptr);
+        break;
+      }
+      // string source_id = 8;
+      case 8: {
+        if (static_cast<::google::protobuf::uint8>(tag) != 66) goto handle_unusual;
+        ptr = ::google::protobuf::io::ReadSize(ptr, &size);
+        GOOGLE_PROTOBUF_PARSER_ASSERT(ptr);
+        ctx->extra_parse_data().SetFieldName("video_processing.VideoFrame.source_id");
+        object = msg->mutable_source_id();
+        if (size > end - ptr + ::google::protobuf::internal::ParseContext::kSlopBytes) {
+          parser_till_end = ::google::protobuf::internal::GreedyStringParserUTF8;
+          goto string_till_end;
+        }
+        GOOGLE_PROTOBUF_PARSER_ASSERT(::google::protobuf::internal::StringCheckUTF8(ptr, size, ctx));
+        ::google::protobuf::internal::InlineGreedyStringParser(object, ptr, size, ctx);
+        ptr += size;
+        break;
+      }
       default: {
       handle_unusual:
         if ((tag & 7) == 4 || tag == 0) {
@@ -1386,6 +1423,34 @@ bool VideoFrame::MergePartialFromCodedStream(
         break;
       }
 
+      // uint32 latency_tier = 7;
+      case 7: {
+        if (static_cast< ::google::protobuf::uint8>(tag) == (56 & 0xFF)) {
+
+          DO_((::google::protobuf::internal::WireFormatLite::ReadPrimitive<
+                   ::google::protobuf::uint32, ::google::protobuf::internal::WireFormatLite::TYPE_UINT32>(
+                 input, &latency_tier_)));
+        } else {
+          goto handle_unusual;
+        }
+        break;
+      }
+
+      // string source_id = 8;
+      case 8: {
+        if (static_cast< ::google::protobuf::uint8>(tag) == (66 & 0xFF)) {
+          DO_(::google::protobuf::internal::WireFormatLite::ReadString(
+                input, this->mutable_source_id()));
+          DO_(::google::protobuf::internal::WireFormatLite::VerifyUtf8String(
+            this->source_id().data(), static_cast<int>(this->source_id().length()),
+            ::google::protobuf::internal::WireFormatLite::PARSE,
+            "video_processing.VideoFrame.source_id"));
+        } else {
+          goto handle_unusual;
+        }
+        break;
+      }
+
       default: {
       handle_unusual:
         if (tag == 0) {
@@ -1451,6 +1516,21 @@ void VideoFrame::SerializeWithCachedSizes(
       6, HasBitSetters::image_pair(this), output);
   }
 
+  // uint32 latency_tier = 7;
+  if (this->latency_tier() != 0) {
+    ::google::protobuf::internal::WireFormatLite::WriteUInt32(7, this->latency_tier(), output);
+  }
+
+  // string source_id = 8;
+  if (this->source_id().size() > 0) {
+    ::google::protobuf::internal::WireFormatLite::VerifyUtf8String(
+      this->source_id().data(), static_cast<int>(this->source_id().length()),
+      ::google::protobuf::internal::WireFormatLite::SERIALIZE,
+      "video_processing.VideoFrame.source_id");
+    ::google::protobuf::internal::WireFormatLite::WriteStringMaybeAliased(
+      8, this->source_id(), output);
+  }
+
   if (_internal_metadata_.have_unknown_fields()) {
     ::google::protobuf::internal::WireFormat::SerializeUnknownFields(
         _internal_metadata_.unknown_fields(), output);
@@ -1505,6 +1585,22 @@ void VideoFrame::SerializeWithCachedSizes(
         6, HasBitSetters::image_pair(this), target);
   }
 
+  // uint32 latency_tier = 7;
+  if (this->latency_tier() != 0) {
+    target = ::google::protobuf::internal::WireFormatLite::WriteUInt32ToArray(7, this->latency_tier(), target);
+  }
+
+  // string source_id = 8;
+  if (this->source_id().size() > 0) {
+    ::google::protobuf::internal::WireFormatLite::VerifyUtf8String(
+      this->source_id().data(), static_cast<int>(this->source_id().length()),
+      ::google::protobuf::internal::WireFormatLite::SERIALIZE,
+      "video_processing.VideoFrame.source_id");
+    target =
+      ::google::protobuf::internal::WireFormatLite::WriteStringToArray(
+        8, this->source_id(), target);
+  }
+
   if (_internal_metadata_.have_unknown_fields()) {
     target = ::google::protobuf::internal::WireFormat::SerializeUnknownFieldsToArray(
         _internal_metadata_.unknown_fields(), target);
@@ -1533,6 +1629,13 @@ size_t VideoFrame::ByteSizeLong() const {
         this->sender_id());
   }
 
+  // string source_id = 8;
+  if (this->source_id().size() > 0) {
+    total_size += 1 +
+      ::google::protobuf::internal::WireFormatLite::StringSize(
+        this->source_id());
+  }
+
   // uint64 frame_id = 1;
   if (this->frame_id() != 0) {
     total_size += 1 +
@@ -1551,6 +1654,13 @@ size_t VideoFrame::ByteSizeLong() const {
       ::google::protobuf::internal::WireFormatLite::EnumSize(this->frame_type());
   }
 
+  // uint32 latency_tier = 7;
+  if (this->latency_tier() != 0) {
+    total_size += 1 +
+      ::google::protobuf::internal::WireFormatLite::UInt32Size(
+        this->latency_tier());
+  }
+
   switch (content_case()) {
     // .video_processing.ImageData single_image = 5;
     case kSingleImage: {
@@ -1601,6 +1711,10 @@ void VideoFrame::MergeFrom(const VideoFrame& from) {
 
     sender_id_.AssignWithDefault(&::google::protobuf::internal::GetEmptyStringAlreadyInited(), from.sender_id_);
   }
+  if (from.source_id().size() > 0) {
+
+    source_id_.AssignWithDefault(&::google::protobuf::internal::GetEmptyStringAlreadyInited(), from.source_id_);
+  }
   if (from.frame_id() != 0) {
     set_frame_id(from.frame_id());
   }
@@ -1610,6 +1724,9 @@ void VideoFrame::MergeFrom(const VideoFrame& from) {
   if (from.frame_type() != 0) {
     set_frame_type(from.frame_type());
   }
+  if (from.latency_tier() != 0) {
+    set_latency_tier(from.latency_tier());
+  }
   switch (from.content_case()) {
     case kSingleImage: {
       mutable_single_image()->::video_processing::ImageData::MergeFrom(from.single_image());
@@ -1652,9 +1769,12 @@ void VideoFrame::InternalSwap(VideoFrame* other) {
   _internal_metadata_.Swap(&other->_internal_metadata_);
   sender_id_.Swap(&other->sender_id_, &::google::protobuf::internal::GetEmptyStringAlreadyInited(),
     GetArenaNoVirtual());
+  source_id_.Swap(&other->source_id_, &::google::protobuf::internal::GetEmptyStringAlreadyInited(),
+    GetArenaNoVirtual());
   swap(frame_id_, other->frame_id_);
   swap(timestamp_, other->timestamp_);
   swap(frame_type_, other->frame_type_);
+  swap(latency_tier_, other->latency_tier_);
   swap(content_, other->content_);
   swap(_oneof_case_[0], other->_oneof_case_[0]);
 }
@@ -117,12 +117,13 @@ enum ImageEncoding {
   PNG = 1,
   BMP = 2,
   RAW = 3,
+  PALETTE_RLE = 4,
   ImageEncoding_INT_MIN_SENTINEL_DO_NOT_USE_ = std::numeric_limits<::google::protobuf::int32>::min(),
   ImageEncoding_INT_MAX_SENTINEL_DO_NOT_USE_ = std::numeric_limits<::google::protobuf::int32>::max()
 };
 bool ImageEncoding_IsValid(int value);
 const ImageEncoding ImageEncoding_MIN = JPEG;
-const ImageEncoding ImageEncoding_MAX = RAW;
+const ImageEncoding ImageEncoding_MAX = PALETTE_RLE;
 const int ImageEncoding_ARRAYSIZE = ImageEncoding_MAX + 1;
 
 const ::google::protobuf::EnumDescriptor* ImageEncoding_descriptor();
@@ -525,6 +526,20 @@ class VideoFrame :
   ::std::string* release_sender_id();
   void set_allocated_sender_id(::std::string* sender_id);
 
+  // string source_id = 8;
+  void clear_source_id();
+  static const int kSourceIdFieldNumber = 8;
+  const ::std::string& source_id() const;
+  void set_source_id(const ::std::string& value);
+  #if LANG_CXX11
+  void set_source_id(::std::string&& value);
+  #endif
+  void set_source_id(const char* value);
+  void set_source_id(const char* value, size_t size);
+  ::std::string* mutable_source_id();
+  ::std::string* release_source_id();
+  void set_allocated_source_id(::std::string* source_id);
+
   // uint64 frame_id = 1;
   void clear_frame_id();
   static const int kFrameIdFieldNumber = 1;
@@ -543,6 +558,12 @@ class VideoFrame :
   ::video_processing::FrameType frame_type() const;
   void set_frame_type(::video_processing::FrameType value);
 
+  // uint32 latency_tier = 7;
+  void clear_latency_tier();
+  static const int kLatencyTierFieldNumber = 7;
+  ::google::protobuf::uint32 latency_tier() const;
+  void set_latency_tier(::google::protobuf::uint32 value);
+
   // .video_processing.ImageData single_image = 5;
   bool has_single_image() const;
   void clear_single_image();
@@ -574,9 +595,11 @@ class VideoFrame :
 
   ::google::protobuf::internal::InternalMetadataWithArena _internal_metadata_;
   ::google::protobuf::internal::ArenaStringPtr sender_id_;
+  ::google::protobuf::internal::ArenaStringPtr source_id_;
   ::google::protobuf::uint64 frame_id_;
   double timestamp_;
   int frame_type_;
+  ::google::protobuf::uint32 latency_tier_;
   union ContentUnion {
     ContentUnion() {}
     ::video_processing::ImageData* single_image_;
@@ -994,6 +1017,73 @@ inline ::video_processing::ImagePair* VideoFrame::mutable_image_pair() {
   return content_.image_pair_;
 }
 
+// uint32 latency_tier = 7;
+inline void VideoFrame::clear_latency_tier() {
+  latency_tier_ = 0u;
+}
+inline ::google::protobuf::uint32 VideoFrame::latency_tier() const {
+  // @@protoc_insertion_point(field_get:video_processing.VideoFrame.latency_tier)
+  return latency_tier_;
+}
+inline void VideoFrame::set_latency_tier(::google::protobuf::uint32 value) {
+  
+  latency_tier_ = value;
+  // @@protoc_insertion_point(field_set:video_processing.VideoFrame.latency_tier)
+}
+
+// string source_id = 8;
+inline void VideoFrame::clear_source_id() {
+  source_id_.ClearToEmptyNoArena(&::google::protobuf::internal::GetEmptyStringAlreadyInited());
+}
+inline const ::std::string& VideoFrame::source_id() const {
+  // @@protoc_insertion_point(field_get:video_processing.VideoFrame.source_id)
+  return source_id_.GetNoArena();
+}
+inline void VideoFrame::set_source_id(const ::std::string& value) {
+  
+  source_id_.SetNoArena(&::google::protobuf::internal::GetEmptyStringAlreadyInited(), value);
+  // @@protoc_insertion_point(field_set:video_processing.VideoFrame.source_id)
+}
+#if LANG_CXX11
+inline void VideoFrame::set_source_id(::std::string&& value) {
+  
+  source_id_.SetNoArena(
+    &::google::protobuf::internal::GetEmptyStringAlreadyInited(), ::std::move(value));
+  // @@protoc_insertion_point(field_set_rvalue:video_processing.VideoFrame.source_id)
+}
+#endif
+inline void VideoFrame::set_source_id(const char* value) {
+  GOOGLE_DCHECK(value != nullptr);
+  
+  source_id_.SetNoArena(&::google::protobuf::internal::GetEmptyStringAlreadyInited(), ::std::string(value));
+  // @@protoc_insertion_point(field_set_char:video_processing.VideoFrame.source_id)
+}
+inline void VideoFrame::set_source_id(const char* value, size_t size) {
+  
+  source_id_.SetNoArena(&::google::protobuf::internal::GetEmptyStringAlreadyInited(),
+      ::std::string(reinterpret_cast<const char*>(value), size));
+  // @@protoc_insertion_point(field_set_pointer:video_processing.VideoFrame.source_id)
+}
+inline ::std::string* VideoFrame::mutable_source_id() {
+  
+  // @@protoc_insertion_point(field_mutable:video_processing.VideoFrame.source_id)
+  return source_id_.MutableNoArena(&::google::protobuf::internal::GetEmptyStringAlreadyInited());
+}
+inline ::std::string* VideoFrame::release_source_id() {
+  // @@protoc_insertion_point(field_release:video_processing.VideoFrame.source_id)
+  
+  return source_id_.ReleaseNoArena(&::google::protobuf::internal::GetEmptyStringAlreadyInited());
+}
+inline void VideoFrame::set_allocated_source_id(::std::string* source_id) {
+  if (source_id != nullptr) {
+    
+  } else {
+    
+  }
+  source_id_.SetAllocatedNoArena(&::google::protobuf::internal::GetEmptyStringAlreadyInited(), source_id);
+  // @@protoc_insertion_point(field_set_allocated:video_processing.VideoFrame.source_id)
+}
+
 inline bool VideoFrame::has_content() const {
   return content_case() != CONTENT_NOT_SET;
 }